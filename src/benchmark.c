@@ -19,12 +19,19 @@
 */
 
 #define _GNU_SOURCE
+#include <ctype.h>
 #include <inttypes.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
 
+#include "bitboard.h"
+#include "evaluate.h"
 #include "misc.h"
+#include "movepick.h"
 #include "position.h"
 #include "search.h"
 #include "settings.h"
@@ -78,6 +85,422 @@ static char *Defaults[] = {
   "8/R7/2q5/8/6k1/8/1P5p/K6R w - - 0 124"  // Draw
 };
 
+// read_fens() returns the positions to be used by a benchmark: the default
+// positions, the current position or the positions found in a file. The
+// number of positions is stored in *num_fens. Returns NULL if the file
+// cannot be opened.
+
+static char **read_fens(Pos *current, char *fenFile, size_t *num_fens)
+{
+  char **fens;
+
+  if (!fenFile || strcmp(fenFile, "default") == 0) {
+    fens = Defaults;
+    *num_fens = sizeof(Defaults) / sizeof(char *);
+  }
+  else if (strcmp(fenFile, "current") == 0) {
+    fens = malloc(sizeof(char *));
+    fens[0] = malloc(128);
+    pos_fen(current, fens[0]);
+    *num_fens = 1;
+  }
+  else {
+    size_t max_fens = 100;
+    *num_fens = 0;
+    FILE *F = fopen(fenFile, "r");
+    if (!F) {
+      fprintf(stderr, "Unable to open file %s\n", fenFile);
+      return NULL;
+    }
+    fens = malloc(max_fens * sizeof(char *));
+    fens[0] = NULL;
+    size_t length = 0;
+    while (getline(&fens[*num_fens], &length, F) > 0) {
+      (*num_fens)++;
+      if (*num_fens == max_fens) {
+        max_fens += 100;
+        fens = realloc(fens, max_fens * sizeof(char *));
+      }
+      fens[*num_fens] = NULL;
+      length = 0;
+    }
+    free(fens[*num_fens]);
+    fclose(F);
+  }
+
+  return fens;
+}
+
+static void free_fens(char **fens, size_t num_fens)
+{
+  if (fens != Defaults) {
+    for (size_t i = 0; i < num_fens; i++)
+      free(fens[i]);
+    free(fens);
+  }
+}
+
+// Lookups done by the slider benchmark, as (square, occupancy) pairs.
+
+#define SLIDER_LOOKUPS 65536
+
+typedef struct {
+  Bitboard occ[SLIDER_LOOKUPS];
+  uint8_t sq[SLIDER_LOOKUPS];
+} SliderSet;
+
+// slider_throughput() returns the average number of cycles per lookup
+// when the lookups are independent of each other.
+
+static double slider_throughput(SliderSet *set, int rook)
+{
+  Bitboard acc = 0;
+  uint64_t best = UINT64_MAX;
+
+  for (int r = 0; r < 20; r++) {
+    uint64_t t = cpu_cycles();
+    if (rook)
+      for (int i = 0; i < SLIDER_LOOKUPS; i++)
+        acc ^= attacks_bb_rook(set->sq[i], set->occ[i]);
+    else
+      for (int i = 0; i < SLIDER_LOOKUPS; i++)
+        acc ^= attacks_bb_bishop(set->sq[i], set->occ[i]);
+    t = cpu_cycles() - t;
+    best = min(best, t);
+  }
+
+  volatile Bitboard sink = acc;
+  (void)sink;
+
+  return (double)best / SLIDER_LOOKUPS;
+}
+
+// slider_latency() returns the average number of cycles per lookup when
+// every lookup depends on the result of the previous one.
+
+static double slider_latency(SliderSet *set, int rook)
+{
+  Bitboard b = 0;
+  uint64_t best = UINT64_MAX;
+
+  for (int r = 0; r < 20; r++) {
+    uint64_t t = cpu_cycles();
+    if (rook)
+      for (int i = 0; i < SLIDER_LOOKUPS; i++)
+        b = attacks_bb_rook(set->sq[i], set->occ[i] ^ (b & 1));
+    else
+      for (int i = 0; i < SLIDER_LOOKUPS; i++)
+        b = attacks_bb_bishop(set->sq[i], set->occ[i] ^ (b & 1));
+    t = cpu_cycles() - t;
+    best = min(best, t);
+  }
+
+  volatile Bitboard sink = b;
+  (void)sink;
+
+  return (double)best / SLIDER_LOOKUPS;
+}
+
+static void slider_report(SliderSet sets[], const char *names[], int num)
+{
+  fprintf(stderr, "\nBackend         : %s\n"
+                  "Table memory    : %" FMT_Z "u bytes\n"
+                  "%-16s %12s %12s %12s %12s\n", slider_backend(),
+                  slider_table_size(), "Occupancies", "bishop thr",
+                  "bishop lat", "rook thr", "rook lat");
+
+  for (int i = 0; i < num; i++)
+    fprintf(stderr, "%-16s %12.2f %12.2f %12.2f %12.2f\n", names[i],
+            slider_throughput(&sets[i], 0), slider_latency(&sets[i], 0),
+            slider_throughput(&sets[i], 1), slider_latency(&sets[i], 1));
+}
+
+// slider_bench() measures attacks_bb_bishop() and attacks_bb_rook() for
+// each slider backend compiled in. It reports cycles per lookup for
+// independent lookups (throughput) and for chains of dependent lookups
+// (latency), on three sets of occupancies: a single square with random
+// occupancies (the touched entries fit in L1), random squares with random
+// occupancies (spread over the whole table) and the squares and
+// occupancies of the pieces in the bench positions. Comparing the three
+// shows how much the table size costs in cache misses.
+
+static void slider_bench(void)
+{
+  static const char *names[] = { "fixed square", "random", "game" };
+  SliderSet *sets = malloc(3 * sizeof(SliderSet));
+  PRNG rng;
+  prng_init(&rng, 1070372);
+
+  for (int i = 0; i < SLIDER_LOOKUPS; i++) {
+    sets[0].sq[i] = SQ_D4;
+    sets[0].occ[i] = prng_rand(&rng) & prng_rand(&rng);
+    sets[1].sq[i] = prng_rand(&rng) & 63;
+    sets[1].occ[i] = prng_rand(&rng) & prng_rand(&rng);
+  }
+
+  Pos pos;
+  pos.stack = malloc(2 * sizeof(Stack));
+  pos.stack++;
+  size_t num_fens = sizeof(Defaults) / sizeof(char *), n = 0;
+  while (n < SLIDER_LOOKUPS)
+    for (size_t i = 0; i < num_fens && n < SLIDER_LOOKUPS; i++) {
+      pos_set(&pos, Defaults[i], 0);
+      Bitboard b = pos.byTypeBB[0];
+      while (b && n < SLIDER_LOOKUPS) {
+        sets[2].sq[n] = pop_lsb(&b);
+        sets[2].occ[n++] = pos.byTypeBB[0];
+      }
+    }
+  free(pos.stack - 1);
+
+  char cpu[64];
+  fprintf(stderr, "CPU features    : %s\n", cpu_features(cpu));
+#ifdef _SC_LEVEL1_DCACHE_SIZE
+  fprintf(stderr, "L1d / L2 cache  : %ld / %ld bytes\n",
+          sysconf(_SC_LEVEL1_DCACHE_SIZE), sysconf(_SC_LEVEL2_CACHE_SIZE));
+#endif
+  fprintf(stderr, "Cycles per lookup, best of 20 runs of %d lookups\n",
+          SLIDER_LOOKUPS);
+
+#ifdef DISPATCH_PLAIN
+  int usePext = UsePext;
+  dispatch_select(0);
+  slider_report(sets, names, 3);
+  if (Cpu.bmi2) {
+    dispatch_select(1);
+    slider_report(sets, names, 3);
+  }
+  dispatch_select(usePext);
+#else
+  slider_report(sets, names, 3);
+#endif
+
+  free(sets);
+}
+
+// movepick_bench() measures the cost of the move picker per node: one
+// mp_init() or mp_init_q() followed by next_move() until all moves have
+// been returned, on the bench positions. The history tables of the main
+// thread are filled with random values so that the moves are not all
+// scored equal, and are cleared again afterwards.
+
+static void movepick_bench(void)
+{
+  const int iterations = 2000;
+  Pos *pos = threads_main();
+  PRNG rng;
+  prng_init(&rng, 1070372);
+
+  search_clear();
+  for (int pc = 0; pc < 16; pc++)
+    for (int sq = 0; sq < 64; sq++) {
+      (*pos->history)[pc][sq] = (Value)(prng_rand(&rng) % 16384) - 8192;
+      for (int i = 0; i < 16 * 64; i++)
+        (&(*pos->counterMoveHistory)[pc][sq][0][0])[i] =
+                (Value)(prng_rand(&rng) % 16384) - 8192;
+    }
+  for (int i = 0; i < 2 * 4096; i++)
+    (&(*pos->fromTo)[0][0])[i] = (Value)(prng_rand(&rng) % 16384) - 8192;
+
+  uint64_t cycles[2] = { 0 }, nodes[2] = { 0 }, moves[2] = { 0 };
+  size_t num_fens = sizeof(Defaults) / sizeof(char *);
+
+  for (size_t i = 0; i < num_fens; i++) {
+    pos_set(pos, Defaults[i], 0);
+    Stack *ss = pos->st;
+    for (int j = -5; j < 3; j++)
+      memset(SStackBegin(ss[j]), 0, SStackSize);
+    (ss-1)->endMoves = pos->moveList;
+    (ss-1)->counterMoves = &(*pos->counterMoveHistory)[W_KNIGHT][SQ_F3];
+    (ss-2)->counterMoves = &(*pos->counterMoveHistory)[B_PAWN][SQ_E5];
+    (ss-4)->counterMoves = &(*pos->counterMoveHistory)[B_KNIGHT][SQ_C6];
+
+    for (int k = 0; k < 2; k++) {
+      uint64_t t = cpu_cycles();
+      for (int j = 0; j < iterations; j++) {
+        if (k == 0)
+          mp_init(pos, 0, 10 * ONE_PLY);
+        else
+          mp_init_q(pos, 0, DEPTH_ZERO, 0);
+        while (next_move(pos))
+          moves[k]++;
+      }
+      cycles[k] += cpu_cycles() - t;
+      nodes[k] += iterations;
+    }
+  }
+
+  search_clear();
+
+  static const char *names[2] = { "main search", "qsearch" };
+
+  fprintf(stderr, "\n==========================="
+                  "\nPositions       : %" FMT_Z "u"
+                  "\nIterations      : %d\n"
+                  "\nPicker              cycles/node   moves/node  cycles/move\n",
+                  num_fens, iterations);
+  for (int k = 0; k < 2; k++)
+    fprintf(stderr, "%-18s %12.1f %12.1f %12.1f\n", names[k],
+            (double)cycles[k] / nodes[k], (double)moves[k] / nodes[k],
+            (double)cycles[k] / max(moves[k], 1));
+}
+
+// board_bench() reports on the board representation this binary was
+// built with (pedantic=yes/no in the Makefile): the size of Pos and Stack,
+// the speed of perft, which mostly exercises move generation and
+// do_move()/undo_move(), and the speed of a fixed depth search on the
+// bench positions. "make board-bench" builds both variants and runs this
+// on each. The perft divide output goes to stdout, the report to stderr.
+
+static void board_bench(void)
+{
+  const int perftDepth = 4, searchDepth = 12;
+  static const char *names[2] = { "perft", "search" };
+  size_t num_fens = sizeof(Defaults) / sizeof(char *);
+  uint64_t nodes[2] = { 0 };
+  TimePoint elapsed[2];
+  LimitsType limits;
+
+  memset(&limits, 0, sizeof(limits));
+  limits.depth = searchDepth;
+
+  delayed_settings.tt_size = 16;
+  delayed_settings.num_threads = 1;
+  process_delayed_settings();
+  search_clear();
+
+  Pos pos;
+  pos.stack = malloc(101 * sizeof(Stack));
+  pos.stack++;
+  pos.moveList = malloc(10000 * sizeof(ExtMove));
+
+  for (int k = 0; k < 2; k++) {
+    elapsed[k] = now();
+    for (size_t i = 0; i < num_fens; i++) {
+      pos_set(&pos, Defaults[i], 0);
+      (pos.st-1)->endMoves = pos.moveList;
+      if (k == 0)
+        nodes[k] += perft(&pos, perftDepth * ONE_PLY);
+      else {
+        limits.startTime = now();
+        threads_start_thinking(&pos, &limits);
+        thread_wait_for_search_finished(threads_main());
+        nodes[k] += threads_nodes_searched();
+      }
+    }
+    elapsed[k] = now() - elapsed[k] + 1;
+  }
+
+  free(pos.stack - 1);
+  free(pos.moveList);
+
+  char cpu[64];
+  fprintf(stderr, "\n==========================="
+#ifdef PEDANTIC
+                  "\nBoard           : pedantic (piece lists in Pos)"
+#else
+                  "\nBoard           : compact (bitboards only)"
+#endif
+                  "\nCPU features    : %s"
+                  "\nBoard bytes     : %" FMT_Z "u"
+                  "\nsizeof(Pos)     : %" FMT_Z "u"
+                  "\nsizeof(Stack)   : %" FMT_Z "u\n"
+                  "\nTest                depth        nodes     ms     nodes/s\n",
+                  cpu_features(cpu), offsetof(Pos, sideToMove), sizeof(Pos),
+                  sizeof(Stack));
+  for (int k = 0; k < 2; k++)
+    fprintf(stderr, "%-18s %6d %12" PRIu64 " %6" PRIu64 " %11" PRIu64 "\n",
+            names[k], k == 0 ? perftDepth : searchDepth, nodes[k],
+            (uint64_t)elapsed[k], 1000 * nodes[k] / elapsed[k]);
+}
+
+#ifdef SEE_STATS
+
+// see_stats_report() prints the SEE calls and cycles of all threads,
+// per searched node. The cycles include reading the cycle counter.
+
+static void see_stats_report(uint64_t nodes)
+{
+  static const char *names[SEE_NB] = {
+    "see", "see_test"
+  };
+  SeeStats total;
+  memset(&total, 0, sizeof(total));
+
+  for (size_t i = 0; i < Threads.num_threads; i++)
+    for (int j = 0; j < SEE_NB; j++) {
+      total.calls[j] += Threads.pos[i]->seeStats.calls[j];
+      total.cycles[j] += Threads.pos[i]->seeStats.cycles[j];
+    }
+
+  fprintf(stderr, "\nSEE function          calls/node  cycles/call  cycles/node\n");
+  for (int j = 0; j < SEE_NB; j++)
+    fprintf(stderr, "%-20s %11.3f %12.1f %12.2f\n", names[j],
+            (double)total.calls[j] / max(nodes, 1),
+            (double)total.cycles[j] / max(total.calls[j], 1),
+            (double)total.cycles[j] / max(nodes, 1));
+}
+
+#endif
+
+#ifdef ORDER_STATS
+
+// order_stats_report() prints the move ordering statistics of all threads.
+// For each move picker stage it shows the moves searched, the beta cutoffs
+// and the fraction of searched moves that cut off, followed by the average
+// move number of the cutoffs among all moves of the node and among the
+// moves of the same stage.
+
+static void order_stats_report(void)
+{
+  static const char *names[OS_NB] = {
+    "tt move", "good captures", "killer 1", "killer 2", "countermove",
+    "quiets", "bad captures", "evasions"
+  };
+  OrderStats total;
+  memset(&total, 0, sizeof(total));
+
+  for (size_t i = 0; i < Threads.num_threads; i++) {
+    OrderStats *os = &Threads.pos[i]->orderStats;
+    for (int j = 0; j < OS_NB; j++) {
+      total.searched[j] += os->searched[j];
+      total.cutoffs[j] += os->cutoffs[j];
+      total.moveNumber[j] += os->moveNumber[j];
+      total.stageNumber[j] += os->stageNumber[j];
+    }
+    total.firstMove += os->firstMove;
+    total.cutNodes += os->cutNodes;
+    total.allNodes += os->allNodes;
+  }
+
+  uint64_t searched = 0, cutoffs = 0, moveNumber = 0;
+  fprintf(stderr, "\nStage              searched    cutoffs  cut rate"
+                  "  of cutoffs  move #  stage #\n");
+  for (int j = 0; j < OS_NB; j++) {
+    fprintf(stderr, "%-14s %12" PRIu64 " %10" PRIu64 " %8.1f%% %10.1f%% %7.2f %8.2f\n",
+            names[j], total.searched[j], total.cutoffs[j],
+            100.0 * total.cutoffs[j] / max(total.searched[j], 1),
+            100.0 * total.cutoffs[j] / max(total.cutNodes, 1),
+            (double)total.moveNumber[j] / max(total.cutoffs[j], 1),
+            (double)total.stageNumber[j] / max(total.cutoffs[j], 1));
+    searched += total.searched[j];
+    cutoffs += total.cutoffs[j];
+    moveNumber += total.moveNumber[j];
+  }
+  fprintf(stderr, "%-14s %12" PRIu64 " %10" PRIu64 " %8.1f%% %10.1f%% %7.2f\n",
+          "total", searched, cutoffs, 100.0 * cutoffs / max(searched, 1),
+          100.0 * cutoffs / max(total.cutNodes, 1),
+          (double)moveNumber / max(cutoffs, 1));
+  fprintf(stderr, "\nCut nodes       : %" PRIu64 " (%.1f%% of %" PRIu64 ")"
+                  "\nFirst move cuts : %.1f%%\n",
+          total.cutNodes,
+          100.0 * total.cutNodes / max(total.cutNodes + total.allNodes, 1),
+          total.cutNodes + total.allNodes,
+          100.0 * total.firstMove / max(total.cutNodes, 1));
+}
+
+#endif
+
 // benchmark() runs a simple benchmark by letting Stockfish analyze a set
 // of positions for a given limit each. There are five parameters: the
 // transposition table size, the number of search threads that should
@@ -102,6 +525,18 @@ void benchmark(Pos *current, char *str)
   char *fenFile = NULL, *limitType = "";
 
   token = strtok(str, " ");
+  if (token && strcmp(token, "sliders") == 0) {
+    slider_bench();
+    return;
+  }
+  if (token && strcmp(token, "movepick") == 0) {
+    movepick_bench();
+    return;
+  }
+  if (token && strcmp(token, "board") == 0) {
+    board_bench();
+    return;
+  }
   if (token) {
     ttSize = atoi(token);
     token = strtok(NULL, " ");
@@ -119,11 +554,24 @@ void benchmark(Pos *current, char *str)
     }
   }
 
+  char cpu[64];
+  fprintf(stderr, "Slider backend  : %s\nCPU features    : %s\n",
+                  slider_backend(), cpu_features(cpu));
+
   delayed_settings.tt_size = ttSize;
   delayed_settings.num_threads = threads;
   process_delayed_settings();
   search_clear();
 
+#ifdef SEE_STATS
+  for (size_t i = 0; i < Threads.num_threads; i++)
+    memset(&Threads.pos[i]->seeStats, 0, sizeof(SeeStats));
+#endif
+#ifdef ORDER_STATS
+  for (size_t i = 0; i < Threads.num_threads; i++)
+    memset(&Threads.pos[i]->orderStats, 0, sizeof(OrderStats));
+#endif
+
   if (strcmp(limitType, "time") == 0)
     limits.movetime = limit; // movetime is in millisecs
   else if (strcmp(limitType, "nodes") == 0)
@@ -133,38 +581,9 @@ void benchmark(Pos *current, char *str)
   else
     limits.depth = limit;
 
-  if (!fenFile || strcmp(fenFile, "default") == 0) {
-    fens = Defaults;
-    num_fens = sizeof(Defaults) / sizeof(char *);
-  }
-  else if (strcmp(fenFile, "current") == 0) {
-    fens = malloc(sizeof(char *));
-    fens[0] = malloc(128);
-    pos_fen(current, fens[0]);
-    num_fens = 1;
-  }
-  else {
-    size_t max_fens = 100;
-    num_fens = 0;
-    FILE *F = fopen(fenFile, "r");
-    if (!F) {
-      fprintf(stderr, "Unable to open file %s\n", fenFile);
-      return;
-    }
-    fens = malloc(max_fens * sizeof(char *));
-    fens[0] = NULL;
-    size_t length = 0;
-    while (getline(&fens[num_fens], &length, F) > 0) {
-      num_fens++;
-      if (num_fens == max_fens) {
-        max_fens += 100;
-        fens = realloc(fens, max_fens * sizeof(char *));
-      }
-      fens[num_fens] = NULL;
-      length = 0;
-    }
-    fclose(F);
-  }
+  fens = read_fens(current, fenFile, &num_fens);
+  if (!fens)
+    return;
 
   uint64_t nodes = 0;
   Pos pos;
@@ -199,12 +618,226 @@ void benchmark(Pos *current, char *str)
                   "\nNodes/second    : %" PRIu64 "\n",
                   elapsed, nodes, 1000 * nodes / elapsed);
 
-  if (fens != Defaults) {
-    for (size_t i = 0; i < num_fens; i++)
-      free(fens[i]);
-    free(fens);
+#ifdef SEE_STATS
+  see_stats_report(nodes);
+#endif
+#ifdef ORDER_STATS
+  order_stats_report();
+#endif
+
+  free_fens(fens, num_fens);
+  free(pos.stack - 1);
+  free(pos.moveList);
+}
+
+
+// eval_prof() runs evaluate() a number of times on each of a set of
+// positions and prints the average number of cycles spent in evaluate()
+// and in each of its main steps. There are two optional parameters: a
+// file name where to look for positions in FEN format (or "default" or
+// "current", as for benchmark()) and the number of evaluations per
+// position (default 1000). Positions in check are skipped.
+
+void eval_prof(Pos *current, char *str)
+{
+  char **fens;
+  size_t num_fens;
+  int iterations = 1000;
+
+  char *fenFile = strtok(str, " ");
+  char *token = strtok(NULL, " ");
+  if (token) iterations = max(1, atoi(token));
+
+  fens = read_fens(current, fenFile, &num_fens);
+  if (!fens)
+    return;
+
+  Pos pos;
+  pos.stack = malloc(2 * sizeof(Stack));
+  pos.stack++;
+  pos.moveList = malloc(MAX_MOVES * sizeof(ExtMove));
+  pos.pawnTable = threads_main()->pawnTable;
+  pos.materialTable = threads_main()->materialTable;
+
+  // The cost of reading the cycle counter is subtracted from every
+  // measurement.
+  uint64_t overhead = UINT64_MAX;
+  for (int i = 0; i < 1000; i++) {
+    uint64_t t = cpu_cycles();
+    t = cpu_cycles() - t;
+    overhead = min(overhead, t);
   }
+
+  EvalProfile prof;
+  memset(&prof, 0, sizeof(prof));
+  uint64_t total = 0, evals = 0, positions = 0, specialized = 0;
+  volatile Value sink;
+
+  for (size_t i = 0; i < num_fens; i++) {
+    pos_set(&pos, fens[i], option_value(OPT_CHESS960));
+    if (pos.st->checkersBB)
+      continue;
+    positions++;
+    for (int j = 0; j < iterations; j++) {
+      uint64_t t = cpu_cycles();
+      sink = evaluate(&pos);
+      total += cpu_cycles() - t - overhead;
+      uint64_t calls = prof.calls[PROF_PIECES];
+      sink = eval_profile(&pos, &prof);
+      specialized += prof.calls[PROF_PIECES] == calls;
+    }
+    evals += iterations;
+  }
+  (void)sink;
+
+  if (!evals) {
+    fprintf(stderr, "No positions to evaluate\n");
+    free_fens(fens, num_fens);
+    free(pos.stack - 1);
+    free(pos.moveList);
+    return;
+  }
+
+  static const char *names[PROF_NB] = {
+    "evaluate_pieces", "evaluate_king", "evaluate_threats",
+    "evaluate_passed_pawns", "evaluate_space"
+  };
+
+  fprintf(stderr, "\n==========================="
+                  "\nPositions       : %" PRIu64
+                  "\nEvaluations     : %" PRIu64
+                  "\nSpecialized     : %" PRIu64
+                  "\nevaluate()      : %.1f cycles/call\n"
+                  "\nTerm                       calls  cycles/call   %% of eval\n",
+                  positions, evals, specialized, (double)total / evals);
+  for (int i = 0; i < PROF_NB; i++) {
+    uint64_t calls = prof.calls[i];
+    double avg = calls ? (double)prof.cycles[i] / calls - overhead : 0.0;
+    fprintf(stderr, "%-22s %10" PRIu64 "  %11.1f  %9.1f%%\n", names[i],
+            calls, avg, 100.0 * avg * calls / total);
+  }
+
+  free_fens(fens, num_fens);
   free(pos.stack - 1);
   free(pos.moveList);
 }
 
+// Shared state of the 'evalbatch' command.
+
+#define BATCH_SIZE 65536
+
+static struct {
+  char *lines[BATCH_SIZE];
+  size_t sizes[BATCH_SIZE];
+  char scores[BATCH_SIZE][16];
+  size_t num;
+  int qsearch;
+  int chess960;
+} Batch;
+
+// eval_batch_task() scores every num_threads-th position of the current
+// batch, starting with the thread's own index.
+
+static void eval_batch_task(Pos *pos)
+{
+#ifdef PEDANTIC
+  size_t step = Threads.num_threads;
+#else
+  // Without PEDANTIC, pos_set() writes to the global castling tables, so
+  // positions can only be set up by one thread at a time.
+  size_t step = 1;
+  if (pos->thread_idx)
+    return;
+#endif
+
+  for (size_t i = pos->thread_idx; i < Batch.num; i += step) {
+    char *fen = Batch.lines[i];
+    while (isblank(*fen))
+      fen++;
+    if (!*fen || *fen == '\n') {
+      strcpy(Batch.scores[i], "none");
+      continue;
+    }
+    pos_set(pos, fen, Batch.chess960);
+    Value v = Batch.qsearch || pos_checkers() ? search_qsearch(pos)
+                                              : evaluate(pos);
+    uci_value(Batch.scores[i], v);
+  }
+}
+
+// eval_batch() reads positions in FEN format from a file, one per line,
+// and writes their static evaluation from the point of view of the side to
+// move to an output file (stdout by default), in the same order and in UCI
+// score format. The positions are evaluated in parallel by the threads of
+// the pool. If the last parameter is "qsearch", the quiescence search value
+// is written instead. Positions in check are always scored by qsearch.
+
+void eval_batch(char *str)
+{
+  char *inFile = strtok(str, " ");
+  char *outFile = strtok(NULL, " ");
+  char *token = strtok(NULL, " ");
+
+  if (!inFile) {
+    fprintf(stderr, "Usage: evalbatch <infile> [outfile|-] [qsearch]\n");
+    return;
+  }
+  if (outFile && strcmp(outFile, "qsearch") == 0 && !token) {
+    token = outFile;
+    outFile = NULL;
+  }
+
+  FILE *in = fopen(inFile, "r");
+  if (!in) {
+    fprintf(stderr, "Unable to open file %s\n", inFile);
+    return;
+  }
+  FILE *out = !outFile || strcmp(outFile, "-") == 0 ? stdout
+                                                    : fopen(outFile, "w");
+  if (!out) {
+    fprintf(stderr, "Unable to open file %s\n", outFile);
+    fclose(in);
+    return;
+  }
+
+  process_delayed_settings();
+  Batch.qsearch = token && strcmp(token, "qsearch") == 0;
+  Batch.chess960 = option_value(OPT_CHESS960);
+
+  uint64_t total = 0;
+  TimePoint elapsed = now();
+
+  do {
+    Batch.num = 0;
+    while (   Batch.num < BATCH_SIZE
+           && getline(&Batch.lines[Batch.num], &Batch.sizes[Batch.num], in) > 0)
+      Batch.num++;
+
+    if (!threads_run(eval_batch_task))
+      break;
+
+    for (size_t i = 0; i < Batch.num; i++)
+      fprintf(out, "%s\n", Batch.scores[i]);
+    total += Batch.num;
+  } while (Batch.num == BATCH_SIZE);
+
+  elapsed = now() - elapsed + 1;
+
+  fclose(in);
+  if (out != stdout)
+    fclose(out);
+  else
+    fflush(stdout);
+
+  for (size_t i = 0; i < BATCH_SIZE; i++) {
+    free(Batch.lines[i]);
+    Batch.lines[i] = NULL;
+    Batch.sizes[i] = 0;
+  }
+
+  fprintf(stderr, "\n==========================="
+                  "\nTotal time (ms) : %" PRIu64
+                  "\nPositions       : %" PRIu64
+                  "\nPositions/second: %" PRIu64 "\n",
+                  elapsed, total, 1000 * total / elapsed);
+}
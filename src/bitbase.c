@@ -19,8 +19,12 @@
 */
 
 #include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
 
 #include "bitboard.h"
+#include "misc.h"
 #include "types.h"
 
 // There are 24 possible pawn squares: the first 4 files and ranks from 2 to 7
@@ -44,11 +48,6 @@ static unsigned index(int us, Square bksq, Square wksq, Square psq)
   return wksq | (bksq << 6) | (us << 12) | (file_of(psq) << 13) | ((RANK_7 - rank_of(psq)) << 15);
 }
 
-#define RES_INVALID 0
-#define RES_UNKNOWN 1
-#define RES_DRAW    2
-#define RES_WIN     4
-
 int bitbases_probe(Square wksq, Square wpsq, Square bksq, int us)
 {
   assert(file_of(wpsq) <= FILE_D);
@@ -57,97 +56,489 @@ int bitbases_probe(Square wksq, Square wpsq, Square bksq, int us)
   return KPKBitbase[idx / 32] & (1 << (idx & 0x1F));
 }
 
-static uint8_t initial(unsigned idx)
+// king_step() moves a bitboard one king step along direction d, dropping
+// the squares that would leave the board.
+static Bitboard king_step(int d, Bitboard b)
 {
-  int ksq[2] = { (idx >> 0) & 0x3f, (idx >> 6) & 0x3f };
-  int us     = (idx >> 12) & 0x01;
-  int psq    = make_square((idx >> 13) & 0x03, RANK_7 - ((idx >> 15) & 0x07));
+  b &= (d & 7) == 1 ? ~FileHBB : (d & 7) == 7 ? ~FileABB : ~0ULL;
+  return d > 0 ? b << d : b >> -d;
+}
+
+static const int KingSteps[8] = {
+  DELTA_N, DELTA_NE, DELTA_E, DELTA_SE, DELTA_S, DELTA_SW, DELTA_W, DELTA_NW
+};
 
-  // Check if two pieces are on the same square or if a king can be captured
-  if (   distance(ksq[WHITE], ksq[BLACK]) <= 1
-      || ksq[WHITE] == psq
-      || ksq[BLACK] == psq
-      || (us == WHITE && (StepAttacksBB[PAWN][psq] & sq_bb(ksq[BLACK]))))
-    return RES_INVALID;
+// The KPK bitbase is computed 64 positions at a time. For each side to
+// move, pawn square and white king square, a bitboard holds the black king
+// squares for which white wins, so that a king move of black becomes a
+// shift and the wins of all black king squares are found together.
+//
+// White to move wins if one move leads to a win. Black to move loses if it
+// has a move and all moves lead to a win. Capturing an undefended pawn
+// leads to a position that is never a win. The sets only grow, and the
+// iteration stops when none of them changes.
+
+void bitbases_init()
+{
+  Bitboard (*win)[64][64] = calloc(2, sizeof(*win)); // [us][psq][wksq]
+  int repeat = 1;
 
   // Immediate win if a pawn can be promoted without getting captured
-  if (   us == WHITE
-      && rank_of(psq) == RANK_7
-      && ksq[us] != psq + DELTA_N
-      && (    distance(ksq[us ^ 1], psq + DELTA_N) > 1
-          || (StepAttacksBB[KING][ksq[us]] & sq_bb((psq + DELTA_N)))))
-    return RES_WIN;
-
-  // Immediate draw if it is a stalemate or a king captures undefended pawn
-  if (   us == BLACK
-      && (  !(StepAttacksBB[KING][ksq[us]] & ~(StepAttacksBB[KING][ksq[us ^ 1]] | StepAttacksBB[PAWN][psq]))
-          || (StepAttacksBB[KING][ksq[us]] & sq_bb(psq) & ~StepAttacksBB[KING][ksq[us ^ 1]])))
-    return RES_DRAW;
-
-  // Position will be classified later
-  return RES_UNKNOWN;
-}
-
-static uint8_t classify(uint8_t *db, unsigned idx)
-{
-  int ksq[2] = { (idx >> 0) & 0x3f, (idx >> 6) & 0x3f };
-  int us     = (idx >> 12) & 0x01;
-  int psq    = make_square((idx >> 13) & 0x03, RANK_7 - ((idx >> 15) & 0x07));
-
-  // White to move: If one move leads to a position classified as WIN, the
-  // result of the current position is WIN. If all moves lead to positions
-  // classified as DRAW, the current position is classified as DRAW,
-  // otherwise the current position is classified as UNKNOWN.
-  //
-  // Black to move: If one move leads to a position classified as DRAW, the
-  // result of the current position is DRAW. If all moves lead to positions
-  // classified as WIN, the position is classified as WIN, otherwise the
-  // current position is classified as UNKNOWN.
-
-  int them = us ^ 1;
-  int good = (us == WHITE ? RES_WIN : RES_DRAW);
-  int bad  = (us == WHITE ? RES_DRAW : RES_WIN);
-
-  uint8_t r = RES_INVALID;
-  Bitboard b = StepAttacksBB[KING][ksq[us]];
-
-  while (b)
-    r |= us == WHITE ? db[index(them, ksq[them]  , pop_lsb(&b), psq)]
-                     : db[index(them, pop_lsb(&b), ksq[them]  , psq)];
-
-  if (us == WHITE) {
-    if (rank_of(psq) < RANK_7)      // Single push
-      r |= db[index(them, ksq[them], ksq[us], psq + DELTA_N)];
-
-    if (   rank_of(psq) == RANK_2   // Double push
-        && psq + DELTA_N != ksq[us]
-        && psq + DELTA_N != ksq[them])
-      r |= db[index(them, ksq[them], ksq[us], psq + DELTA_N + DELTA_N)];
+  for (int f = FILE_A; f <= FILE_D; f++) {
+    Square psq = make_square(f, RANK_7), q = psq + DELTA_N;
+    for (Square wksq = 0; wksq < 64; wksq++)
+      if (wksq != psq && wksq != q)
+        win[WHITE][psq][wksq] =
+                ~(StepAttacksBB[KING][wksq] | sq_bb(wksq) | sq_bb(psq))
+              & ~StepAttacksBB[PAWN][psq]
+              & (StepAttacksBB[KING][wksq] & sq_bb(q) ? ~0ULL
+                                 : ~(StepAttacksBB[KING][q] | sq_bb(q)));
+  }
+
+  while (repeat) {
+    repeat = 0;
+    for (int r = RANK_7; r >= RANK_2; r--)
+      for (int f = FILE_A; f <= FILE_D; f++) {
+        Square psq = make_square(f, r);
+        for (Square wksq = 0; wksq < 64; wksq++) {
+          if (wksq == psq)
+            continue;
+
+          // Black king squares of legal positions, and those it may move to
+          Bitboard valid = ~(StepAttacksBB[KING][wksq] | sq_bb(wksq) | sq_bb(psq));
+          Bitboard safe  = ~(StepAttacksBB[KING][wksq] | sq_bb(wksq) | StepAttacksBB[PAWN][psq]);
+
+          // Black to move
+          Bitboard moves = 0, b = ~0ULL;
+          for (int i = 0; i < 8; i++) {
+            Bitboard legal = king_step(KingSteps[i], safe);
+            moves |= legal;
+            b &= ~legal | king_step(KingSteps[i], win[WHITE][psq][wksq]);
+          }
+          b &= moves & valid;
+          repeat |= b != win[BLACK][psq][wksq];
+          win[BLACK][psq][wksq] = b;
+
+          // White to move
+          b = win[WHITE][psq][wksq];
+          Bitboard k = StepAttacksBB[KING][wksq];
+          while (k)
+            b |= win[BLACK][psq][pop_lsb(&k)];
+
+          if (r < RANK_7 && psq + DELTA_N != wksq) {
+            b |= win[BLACK][psq + DELTA_N][wksq];   // Single push
+            if (r == RANK_2)                       // Double push
+              b |= win[BLACK][psq + DELTA_N + DELTA_N][wksq] & ~sq_bb(psq + DELTA_N);
+          }
+          b &= valid & ~StepAttacksBB[PAWN][psq];
+          repeat |= b != win[WHITE][psq][wksq];
+          win[WHITE][psq][wksq] = b;
+        }
+      }
   }
 
-  return db[idx] = r & good  ? good  : r & RES_UNKNOWN ? RES_UNKNOWN : bad;
+  // Map 32 results into one KPKBitbase[] entry
+  for (int us = WHITE; us <= BLACK; us++)
+    for (int r = RANK_2; r <= RANK_7; r++)
+      for (int f = FILE_A; f <= FILE_D; f++) {
+        Square psq = make_square(f, r);
+        for (Square wksq = 0; wksq < 64; wksq++)
+          for (Bitboard b = win[us][psq][wksq]; b; ) {
+            unsigned idx = index(us, pop_lsb(&b), wksq, psq);
+            KPKBitbase[idx / 32] |= 1UL << (idx & 0x1F);
+          }
+      }
+
+  free(win);
 }
 
-void bitbases_init()
+
+
+// Bitbases for endgames with more pieces are built by a generic retrograde
+// generator. A bitbase covers the positions of the two kings and of up to
+// BITBASE_PIECES other pieces, the first of which is a white pawn that is
+// kept on files A-D by mirroring, and tells for each of them whether white
+// wins.
+//
+// An index is mapped as follows:
+//
+// bit     0: side to move (WHITE or BLACK)
+// bit  1- 6: white king square
+// bit  7-12: black king square
+// bit 13-17: white pawn file (2 bits) and rank - RANK_2 (3 bits)
+// bit 18-  : square of each other piece (6 bits each)
+
+#define BITBASE_PIECES 3
+
+typedef struct {
+  char *code;
+  int num;
+  Piece pieces[BITBASE_PIECES];
+  unsigned size;
+  uint32_t *table;
+} Bitbase;
+
+static Bitbase Bitbases[BB_NB] = {
+  { "KBPk", 2, { W_PAWN, W_BISHOP }, 0, NULL },
+  { "KPkp", 2, { W_PAWN, B_PAWN }, 0, NULL }
+};
+
+typedef struct {
+  Square ksq[2];
+  Square sq[BITBASE_PIECES];
+  int us;
+} BBPos;
+
+static unsigned bb_index(const Bitbase *bb, const BBPos *p)
 {
-  uint8_t *db = malloc(MAX_INDEX);
-  unsigned idx, repeat = 1;
+  unsigned idx =   p->us | (p->ksq[WHITE] << 1) | (p->ksq[BLACK] << 7)
+                 | (file_of(p->sq[0]) << 13) | ((rank_of(p->sq[0]) - RANK_2) << 15);
+  for (int i = 1; i < bb->num; i++)
+    idx |= p->sq[i] << (12 + 6 * i);
+  return idx;
+}
 
-  // Initialize db with known win / draw positions
-  for (idx = 0; idx < MAX_INDEX; idx++)
-    db[idx] = initial(idx);
+// bb_decode() returns 0 if idx does not encode a valid position.
+static int bb_decode(const Bitbase *bb, unsigned idx, BBPos *p)
+{
+  p->us = idx & 1;
+  p->ksq[WHITE] = (idx >> 1) & 0x3f;
+  p->ksq[BLACK] = (idx >> 7) & 0x3f;
+  if (((idx >> 15) & 7) > RANK_7 - RANK_2)
+    return 0;
+  p->sq[0] = make_square((idx >> 13) & 3, RANK_2 + ((idx >> 15) & 7));
+  for (int i = 1; i < bb->num; i++)
+    p->sq[i] = (idx >> (12 + 6 * i)) & 0x3f;
 
-  // Iterate through the positions until none of the unknown positions can be
-  // changed to either wins or draws (15 cycles needed).
-  while (repeat)
-    for (repeat = idx = 0; idx < MAX_INDEX; idx++)
-      repeat |= (db[idx] == RES_UNKNOWN && classify(db, idx) != RES_UNKNOWN);
+  Bitboard occ = sq_bb(p->ksq[WHITE]) | sq_bb(p->ksq[BLACK]);
+  if (distance(p->ksq[WHITE], p->ksq[BLACK]) <= 1)
+    return 0;
+  for (int i = 0; i < bb->num; i++) {
+    if (   (occ & sq_bb(p->sq[i]))
+        || (   type_of_p(bb->pieces[i]) == PAWN
+            && (rank_of(p->sq[i]) == RANK_1 || rank_of(p->sq[i]) == RANK_8)))
+      return 0;
+    occ |= sq_bb(p->sq[i]);
+  }
+  return 1;
+}
 
-  // Map 32 results into one KPKBitbase[] entry
-  for (idx = 0; idx < MAX_INDEX; ++idx)
-      if (db[idx] == RES_WIN)
-          KPKBitbase[idx / 32] |= 1UL << (idx & 0x1F);
+static Bitboard bb_occupied(const Bitbase *bb, const BBPos *p, int skip)
+{
+  Bitboard occ = sq_bb(p->ksq[WHITE]) | sq_bb(p->ksq[BLACK]);
+  for (int i = 0; i < bb->num; i++)
+    if (i != skip)
+      occ |= sq_bb(p->sq[i]);
+  return occ;
+}
+
+// bb_attacked() returns whether square s is attacked by side c, ignoring
+// the piece with number skip, which has been captured.
+static int bb_attacked(const Bitbase *bb, const BBPos *p, int c, Square s,
+                       int skip)
+{
+  Bitboard occ = bb_occupied(bb, p, skip);
+
+  if (StepAttacksBB[KING][p->ksq[c]] & sq_bb(s))
+    return 1;
+  for (int i = 0; i < bb->num; i++)
+    if (   i != skip && color_of(bb->pieces[i]) == c
+        && (attacks_bb(bb->pieces[i], p->sq[i], occ) & sq_bb(s)))
+      return 1;
+  return 0;
+}
+
+#define BB_INVALID 0
+#define BB_UNKNOWN 1
+#define BB_DRAW    2
+#define BB_WIN     3
+#define BB_NEWWIN  4
+
+// bb_capture() returns the result for white of position p, where piece
+// number skip has just been captured, by probing the bitbase of the
+// remaining material. Material without a bitbase counts as a draw.
+static int bb_capture(const Bitbase *bb, const BBPos *p, int skip)
+{
+  Square s[BITBASE_PIECES];
+  Piece pc[BITBASE_PIECES];
+  int n = 0;
 
+  for (int i = 0; i < bb->num; i++)
+    if (i != skip) {
+      s[n] = p->sq[i];
+      pc[n++] = bb->pieces[i];
+    }
+
+  if (n != 1 || pc[0] != W_PAWN)
+    return BB_DRAW;
+
+  // Only KPK is left. It is probed with the pawn on files A-D.
+  int mirror = file_of(s[0]) >= FILE_E ? 0x07 : 0;
+  return bitbases_probe(p->ksq[WHITE] ^ mirror, s[0] ^ mirror,
+                        p->ksq[BLACK] ^ mirror, p->us) ? BB_WIN : BB_DRAW;
+}
+
+// bb_promotion() returns the result for white of position p, black to
+// move, where the white pawn has just promoted on square s. As in the KPK
+// bitbase, white is assumed to win if the new queen cannot be captured,
+// unless a black pawn is about to promote as well.
+static int bb_promotion(const Bitbase *bb, const BBPos *p, Square s)
+{
+  if (   (StepAttacksBB[KING][p->ksq[BLACK]] & sq_bb(s))
+      && !bb_attacked(bb, p, WHITE, s, 0))
+    return BB_DRAW;
+
+  for (int i = 1; i < bb->num; i++)
+    if (bb->pieces[i] == B_PAWN && rank_of(p->sq[i]) == RANK_2)
+      return BB_DRAW;
+
+  return BB_WIN;
+}
+
+// bb_moves() generates the legal moves of position p and returns their
+// number. The results of the moves that leave the bitbase are or-ed into
+// *outcome as 1 << result, the moves that stay in it are counted in
+// *inCount.
+static int bb_moves(const Bitbase *bb, BBPos *p, int *outcome, int *inCount)
+{
+  int us = p->us, them = us ^ 1, num = 0;
+  Bitboard occ = bb_occupied(bb, p, -1);
+  Bitboard own = sq_bb(p->ksq[us]), other = sq_bb(p->ksq[them]);
+
+  // The squares attacked by them, seen through our king, tell whether a
+  // king move that does not capture is legal. Without sliders of theirs,
+  // other moves are legal unless we are in check.
+  Bitboard danger = StepAttacksBB[KING][p->ksq[them]];
+  int sliders = 0;
+
+  for (int i = 0; i < bb->num; i++)
+    if (color_of(bb->pieces[i]) == us)
+      own |= sq_bb(p->sq[i]);
+    else {
+      other |= sq_bb(p->sq[i]);
+      danger |= attacks_bb(bb->pieces[i], p->sq[i], occ ^ sq_bb(p->ksq[us]));
+      sliders |= type_of_p(bb->pieces[i]) >= BISHOP;
+    }
+  int safe = !sliders && !(danger & sq_bb(p->ksq[us]));
+
+  *outcome = 0;
+  *inCount = 0;
+
+  // King moves
+  Square from = p->ksq[us];
+  Bitboard b = StepAttacksBB[KING][from] & ~own;
+  while (b) {
+    Square to = pop_lsb(&b);
+    int captured = -1;
+    for (int j = 0; j < bb->num; j++)
+      if (p->sq[j] == to && color_of(bb->pieces[j]) == them)
+        captured = j;
+    p->ksq[us] = to;
+    if (captured < 0 ? !(danger & sq_bb(to)) : !bb_attacked(bb, p, them, to, captured)) {
+      num++;
+      p->us = them;
+      if (captured >= 0)
+        *outcome |= 1 << bb_capture(bb, p, captured);
+      else
+        (*inCount)++;
+      p->us = us;
+    }
+    p->ksq[us] = from;
+  }
+
+  // Piece moves
+  for (int i = 0; i < bb->num; i++) {
+    Piece pc = bb->pieces[i];
+    if (color_of(pc) != us)
+      continue;
+    from = p->sq[i];
+    if (type_of_p(pc) == PAWN) {
+      int push = us == WHITE ? 8 : -8;
+      b = StepAttacksBB[pc][from] & other & ~sq_bb(p->ksq[them]);
+      if (!(occ & sq_bb(from + push))) {
+        b |= sq_bb(from + push);
+        if (   rank_of(from) == (us == WHITE ? RANK_2 : RANK_7)
+            && !(occ & sq_bb(from + 2 * push)))
+          b |= sq_bb(from + 2 * push);
+      }
+    } else
+      b = attacks_bb(pc, from, occ) & ~own & ~sq_bb(p->ksq[them]);
+
+    while (b) {
+      Square to = pop_lsb(&b);
+      int captured = -1;
+      for (int j = 0; j < bb->num; j++)
+        if (p->sq[j] == to && color_of(bb->pieces[j]) == them)
+          captured = j;
+      p->sq[i] = to;
+      if (safe || !bb_attacked(bb, p, them, p->ksq[us], captured)) {
+        num++;
+        p->us = them;
+        // Promotions with capture do not occur in the bitbases below, as
+        // black has no pieces besides pawns, and count as draws.
+        if (type_of_p(pc) == PAWN && (rank_of(to) == RANK_1 || rank_of(to) == RANK_8))
+          *outcome |= 1 << (us == WHITE && captured < 0 ? bb_promotion(bb, p, to)
+                                                        : BB_DRAW);
+        else if (captured >= 0)
+          *outcome |= 1 << bb_capture(bb, p, captured);
+        else
+          (*inCount)++;
+        p->us = us;
+      }
+      p->sq[i] = from;
+    }
+  }
+
+  return num;
+}
+
+// bb_unmoves() updates the positions from which a legal move leads to the
+// position p, which has just been found to be a win. A position with white
+// to move is then won too, one with black to move when all its moves
+// within the bitbase lead to wins.
+static void bb_unmoves(const Bitbase *bb, const BBPos *p, uint8_t *db,
+                       uint8_t *cnt)
+{
+  int them = p->us ^ 1;
+  Bitboard occ = bb_occupied(bb, p, -1);
+  BBPos q = *p;
+  q.us = them;
+
+  for (int i = -1; i < bb->num; i++) {
+    Square s = i < 0 ? p->ksq[them] : p->sq[i];
+    Bitboard b;
+
+    if (i < 0)
+      b = StepAttacksBB[KING][s] & ~occ & ~StepAttacksBB[KING][p->ksq[p->us]];
+    else if (color_of(bb->pieces[i]) != them)
+      continue;
+    else if (type_of_p(bb->pieces[i]) == PAWN) {
+      int push = them == WHITE ? 8 : -8;
+      b = 0;
+      if (   relative_rank(them, rank_of(s)) >= RANK_3
+          && !(occ & sq_bb(s - push))) {
+        b |= sq_bb(s - push);
+        if (   relative_rank(them, rank_of(s)) == RANK_4
+            && !(occ & sq_bb(s - 2 * push)))
+          b |= sq_bb(s - 2 * push);
+      }
+    } else
+      b = attacks_bb(bb->pieces[i], s, occ) & ~occ;
+
+    while (b) {
+      Square from = pop_lsb(&b);
+      if (i < 0)
+        q.ksq[them] = from;
+      else
+        q.sq[i] = from;
+      // Predecessors that are not legal positions are BB_INVALID.
+      unsigned idx = bb_index(bb, &q);
+      if (db[idx] == BB_UNKNOWN && (them == WHITE || !--cnt[idx]))
+        db[idx] = BB_NEWWIN;
+    }
+    if (i < 0)
+      q.ksq[them] = s;
+    else
+      q.sq[i] = s;
+  }
+}
+
+// bb_generate() builds bitbase bb by retrograde analysis: the positions
+// that are won without a move within the bitbase are found first, then
+// wins are propagated backwards until none is left.
+static void bb_generate(Bitbase *bb)
+{
+  unsigned idx;
+  int repeat, outcome, inCount;
+  BBPos p;
+
+  bb->size = 1U << (18 + 6 * (bb->num - 1));
+  uint8_t *db = malloc(bb->size);
+  uint8_t *cnt = malloc(bb->size);
+
+  for (idx = 0; idx < bb->size; idx++) {
+    if (   !bb_decode(bb, idx, &p)
+        || bb_attacked(bb, &p, p.us, p.ksq[p.us ^ 1], -1)) {
+      db[idx] = BB_INVALID;
+      continue;
+    }
+    int num = bb_moves(bb, &p, &outcome, &inCount);
+    cnt[idx] = inCount;
+    if (p.us == WHITE)
+      db[idx] =  outcome & (1 << BB_WIN) ? BB_NEWWIN
+               : inCount                 ? BB_UNKNOWN : BB_DRAW;
+    else if (!num)
+      db[idx] = bb_attacked(bb, &p, WHITE, p.ksq[BLACK], -1) ? BB_NEWWIN : BB_DRAW;
+    else
+      db[idx] =  outcome & (1 << BB_DRAW) ? BB_DRAW
+               : inCount                  ? BB_UNKNOWN : BB_NEWWIN;
+  }
+
+  do {
+    repeat = 0;
+    for (idx = 0; idx < bb->size; idx++)
+      if (db[idx] == BB_NEWWIN) {
+        db[idx] = BB_WIN;
+        bb_decode(bb, idx, &p);
+        bb_unmoves(bb, &p, db, cnt);
+        repeat = 1;
+      }
+  } while (repeat);
+
+  bb->table = calloc(bb->size / 32, sizeof(uint32_t));
+  for (idx = 0; idx < bb->size; idx++)
+    if (db[idx] == BB_WIN)
+      bb->table[idx / 32] |= 1U << (idx & 0x1F);
+
+  free(cnt);
   free(db);
 }
 
+// bitbases_generate() builds the bitbases of endgames other than KPK and
+// reports the time and memory they took. bitbases_free() releases them.
+void bitbases_generate(void)
+{
+  for (int i = 0; i < BB_NB; i++) {
+    Bitbase *bb = &Bitbases[i];
+    if (bb->table)
+      continue;
+    TimePoint start = now();
+    bb_generate(bb);
+    printf("info string Bitbase %s: %u positions, %u kB (%u kB while "
+           "generating) in %" PRIu64 " ms\n", bb->code, bb->size,
+           bb->size / 8 / 1024, bb->size * 2 / 1024,
+           (uint64_t)(now() - start));
+  }
+  fflush(stdout);
+}
+
+void bitbases_free(void)
+{
+  for (int i = 0; i < BB_NB; i++) {
+    free(Bitbases[i].table);
+    Bitbases[i].table = NULL;
+  }
+}
+
+// bitbase_probe() returns 1 if white wins the position of bitbase id with
+// side us to move, the kings on wksq and bksq and the other pieces on sq[],
+// 0 if it does not, and -1 if the bitbase was not generated. The white pawn
+// must be on files A-D.
+int bitbase_probe(int id, int us, Square wksq, Square bksq, const Square *sq)
+{
+  const Bitbase *bb = &Bitbases[id];
+  if (!bb->table)
+    return -1;
+
+  assert(file_of(sq[0]) <= FILE_D);
+
+  BBPos p;
+  p.us = us;
+  p.ksq[WHITE] = wksq;
+  p.ksq[BLACK] = bksq;
+  for (int i = 0; i < bb->num; i++)
+    p.sq[i] = sq[i];
+
+  unsigned idx = bb_index(bb, &p);
+  return (bb->table[idx / 32] >> (idx & 0x1F)) & 1;
+}
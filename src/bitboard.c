@@ -53,6 +53,8 @@ static Bitboard sliding_attack(Square deltas[], Square sq, Bitboard occupied)
 #include "bmi2-fancy.c"
 #elif defined(BMI2_PLAIN)
 #include "bmi2-plain.c"
+#elif defined(DISPATCH_PLAIN)
+#include "dispatch-plain.c"
 #endif
 
 Bitboard SquareBB[64];
@@ -72,13 +74,12 @@ Bitboard PseudoAttacks[8][64];
 #ifndef PEDANTIC
 Bitboard EPMask[16];
 Bitboard CastlingPath[64];
-int CastlingRightsMask[64];
-Square CastlingRookSquare[16];
+uint8_t CastlingRightsMask[64];
+uint8_t CastlingRookSquare[16];
 Key CastlingHash[16];
 Bitboard CastlingBits[16];
 Score CastlingPSQ[16];
-Square CastlingRookFrom[16];
-Square CastlingRookTo[16];
+uint8_t CastlingRookTo[16];
 #endif
 
 // De Bruijn sequences. See chessprogramming.wikispaces.com/BitScan.
@@ -168,6 +169,40 @@ void print_pretty(Bitboard b)
 }
 
 
+// slider_backend() returns the name of the implementation used for slider
+// attacks. With DISPATCH_PLAIN this is only known after bitboards_init().
+
+const char *slider_backend(void)
+{
+#if defined(MAGIC_FANCY)
+  return "magic-fancy";
+#elif defined(MAGIC_PLAIN)
+  return "magic-plain";
+#elif defined(BMI2_FANCY)
+  return "bmi2-fancy";
+#elif defined(BMI2_PLAIN)
+  return "bmi2-plain";
+#elif defined(DISPATCH_PLAIN)
+  return UsePext ? "bmi2-plain (dispatched)" : "magic-plain (dispatched)";
+#endif
+}
+
+
+// slider_table_size() returns the size in bytes of the slider attack
+// tables of the backend in use.
+
+size_t slider_table_size(void)
+{
+#if defined(MAGIC_PLAIN)
+  return sizeof(AttacksTable);
+#elif defined(DISPATCH_PLAIN)
+  return UsePext ? sizeof(PextTable) : sizeof(AttacksTable);
+#else
+  return sizeof(RookTable) + sizeof(BishopTable);
+#endif
+}
+
+
 // bitboards_init() initializes various bitboard tables. It is called at
 // startup and relies on global objects to be already zero-initialized.
 
@@ -28,8 +28,16 @@
 void bitbases_init();
 int bitbases_probe(Square wksq, Square wpsq, Square bksq, int us);
 
+enum { BB_KBPK, BB_KPKP, BB_NB };
+
+void bitbases_generate(void);
+void bitbases_free(void);
+int bitbase_probe(int id, int us, Square wksq, Square bksq, const Square *sq);
+
 void bitboards_init();
 void print_pretty(Bitboard b);
+const char *slider_backend(void);
+size_t slider_table_size(void);
 
 #define DarkSquares  0xAA55AA55AA55AA55ULL
 #define LightSquares (~DarkSquares)
@@ -73,11 +81,9 @@ extern Bitboard EPMask[16];
 extern Bitboard CastlingPath[64];
 extern uint8_t CastlingRightsMask[64];
 extern uint8_t CastlingRookSquare[16];
-extern uint8_t CastlingToSquare[16]; // To correct the KxR encoding.
 extern Key CastlingHash[16];
 extern Bitboard CastlingBits[16];
 extern Score CastlingPSQ[16];
-extern uint8_t CastlingRookFrom[16];
 extern uint8_t CastlingRookTo[16];
 #endif
 
@@ -249,6 +255,8 @@ INLINE int distance_r(Square x, Square y)
 #include "bmi2-fancy.h"
 #elif defined(BMI2_PLAIN)
 #include "bmi2-plain.h"
+#elif defined(DISPATCH_PLAIN)
+#include "dispatch-plain.h"
 #endif
 
 INLINE Bitboard attacks_bb(Piece pc, Square s, Bitboard occupied)
@@ -1,11 +1,38 @@
 #ifndef CONFIG_H
 #define CONFIG_H
 
+// PEDANTIC keeps piece counts, piece lists and the castling tables in Pos.
+// Without it the board consists of bitboards only and the castling tables
+// are global. Build with pedantic=no to get the compact board, and compare
+// both with "make board-bench".
+#if !defined(PEDANTIC) && !defined(NO_PEDANTIC)
 #define PEDANTIC
+#endif
+
+// Maintain per-square attack tables incrementally in do_move()/undo_move().
+//#define ATTACK_MAP
+
+// Let undo_move() restore a copy of the board saved by do_move() instead
+// of unmaking the move piece by piece.
+//#define COPY_MAKE
+
+// Count the calls to and the cycles spent in the SEE functions per thread
+// and report them at the end of "bench".
+//#define SEE_STATS
+
+// Count the moves searched and the beta cutoffs per move picker stage per
+// thread and report them at the end of "bench".
+//#define ORDER_STATS
 
-#ifdef USE_PEXT
+// A slider backend can also be chosen on the command line, for example
+// with EXTRACFLAGS=-DMAGIC_FANCY, to compare them with "bench sliders".
+#if defined(MAGIC_PLAIN) || defined(MAGIC_FANCY) \
+    || defined(BMI2_PLAIN) || defined(BMI2_FANCY)
+#elif defined(USE_DISPATCH)
+#define DISPATCH_PLAIN
+#elif defined(USE_PEXT)
 #define BMI2_PLAIN
-//#define BMI2_FANCY
+//#define BMI2_FANCY    // 16-bit entries expanded with pdep(), 210 KB
 #else
 #define MAGIC_PLAIN
 //#define MAGIC_FANCY
@@ -0,0 +1,56 @@
+// The magic tables and their initialisation are shared with magic-plain.c.
+// Its AttacksTable is used for the magic layout, PextTable for the BMI2
+// layout.
+
+#define init_sliding_attacks init_magic_plain
+#include "magic-plain.c"
+#undef init_sliding_attacks
+
+int UsePext;
+
+static Bitboard PextTable[102400 + 5248];
+
+static void init_bmi2(Bitboard table[], Bitboard *attacks[], Bitboard masks[],
+                      Square deltas[], Fn index)
+{
+  Bitboard edges, b;
+
+  for (int s = 0; s < 64; s++) {
+    attacks[s] = table;
+
+    // Board edges are not considered in the relevant occupancies
+    edges = ((Rank1BB | Rank8BB) & ~rank_bb_s(s)) | ((FileABB | FileHBB) & ~file_bb_s(s));
+
+    masks[s] = sliding_attack(deltas, s, 0) & ~edges;
+
+    b = 0;
+    do {
+      attacks[s][index(s, b)] = sliding_attack(deltas, s, b);
+      b = (b - masks[s]) & masks[s];
+      table++;
+    } while (b);
+  }
+}
+
+
+// dispatch_select() switches to pext indexing if usePext is set and the
+// CPU supports pext, otherwise to magics, and rebuilds the attack tables.
+// Must not be called while searching.
+
+void dispatch_select(int usePext)
+{
+  UsePext = usePext && Cpu.bmi2;
+
+  if (UsePext) {
+    init_bmi2(PextTable, RookAttacks, RookMasks, RookDeltas, bmi2_index_rook);
+    init_bmi2(PextTable + 102400, BishopAttacks, BishopMasks, BishopDeltas,
+              bmi2_index_bishop);
+  } else
+    init_magic_plain();
+}
+
+
+static void init_sliding_attacks(void)
+{
+  dispatch_select(Cpu.fastPext);
+}
@@ -0,0 +1,56 @@
+// Plain magics or plain BMI2, selected at startup by init_sliding_attacks()
+// depending on whether the CPU has a fast pext instruction. Both share the
+// masks and the attack pointers; only the index computation differs. The
+// branch on UsePext is perfectly predictable.
+
+extern Bitboard RookMasks[64];
+extern Bitboard RookMagics[64];
+extern Bitboard BishopMasks[64];
+extern Bitboard BishopMagics[64];
+extern Bitboard *RookAttacks[64];
+extern Bitboard *BishopAttacks[64];
+extern int UsePext;
+
+void dispatch_select(int usePext);
+
+// pext is emitted directly so that the rest of the program can be compiled
+// without -mbmi2. It is only executed if the CPU supports it.
+
+INLINE Bitboard pext_asm(Bitboard b, Bitboard m)
+{
+  Bitboard r;
+  __asm__ ("pextq %2, %1, %0" : "=r"(r) : "r"(b), "rm"(m));
+  return r;
+}
+
+INLINE unsigned magic_index_bishop(Square s, Bitboard occupied)
+{
+  return ((occupied & BishopMasks[s]) * BishopMagics[s]) >> (64-9);
+}
+
+INLINE unsigned magic_index_rook(Square s, Bitboard occupied)
+{
+  return ((occupied & RookMasks[s]) * RookMagics[s]) >> (64-12);
+}
+
+INLINE unsigned bmi2_index_bishop(Square s, Bitboard occupied)
+{
+  return (unsigned)pext_asm(occupied, BishopMasks[s]);
+}
+
+INLINE unsigned bmi2_index_rook(Square s, Bitboard occupied)
+{
+  return (unsigned)pext_asm(occupied, RookMasks[s]);
+}
+
+INLINE Bitboard attacks_bb_bishop(Square s, Bitboard occupied)
+{
+  return BishopAttacks[s][UsePext ? bmi2_index_bishop(s, occupied)
+                                  : magic_index_bishop(s, occupied)];
+}
+
+INLINE Bitboard attacks_bb_rook(Square s, Bitboard occupied)
+{
+  return RookAttacks[s][UsePext ? bmi2_index_rook(s, occupied)
+                                : magic_index_rook(s, occupied)];
+}
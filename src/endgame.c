@@ -363,7 +363,8 @@ Value EvaluateKNNK(Pos *pos, int strongSide)
 // KB and one or more pawns vs K. It checks for draws with rook pawns
 // and a bishop of the wrong color. If such a draw is detected,
 // SCALE_FACTOR_DRAW is returned. If not, the return value is
-// SCALE_FACTOR_NONE, i.e. no scaling will be used.
+// SCALE_FACTOR_NONE, i.e. no scaling will be used. KBP vs K is looked up
+// in the KBPK bitbase if the Bitbases option is set.
 int ScaleKBPsK(Pos *pos, int strongSide)
 {
   int weakSide = strongSide ^ 1;
@@ -374,6 +375,19 @@ int ScaleKBPsK(Pos *pos, int strongSide)
   // No assertions about the material of weakSide, because we want draws to
   // be detected even when the weaker side has some pawns.
 
+  // With a single pawn against a bare king, the KBPK bitbase is exact.
+  if (   piece_count(strongSide, PAWN) == 1
+      && popcount(pieces_c(weakSide)) == 1) {
+    Square sq[2] = { normalize(pos, strongSide, square_of(strongSide, PAWN)),
+                     normalize(pos, strongSide, square_of(strongSide, BISHOP)) };
+    int r = bitbase_probe(BB_KBPK, strongSide == pos_stm() ? WHITE : BLACK,
+                          normalize(pos, strongSide, square_of(strongSide, KING)),
+                          normalize(pos, strongSide, square_of(weakSide, KING)),
+                          sq);
+    if (r >= 0)
+      return r ? SCALE_FACTOR_NONE : SCALE_FACTOR_DRAW;
+  }
+
   Bitboard pawns = pieces_cp(strongSide, PAWN);
   int pawnsFile = file_of(lsb(pawns));
 
@@ -851,7 +865,8 @@ int ScaleKNPKB(Pos *pos, int strongSide)
 // it probably has at least a draw with the pawn as well. The exception
 // is when the stronger side's pawn is far advanced and not on a rook
 // file; in this case it is often possible to win
-// (e.g. 8/4k3/3p4/3P4/6K1/8/8/8 w - - 0 1).
+// (e.g. 8/4k3/3p4/3P4/6K1/8/8/8 w - - 0 1). If the Bitbases option is set,
+// the KPKP bitbase is probed instead.
 int ScaleKPKP(Pos *pos, int strongSide)
 {
   int weakSide = strongSide ^ 1;
@@ -866,6 +881,12 @@ int ScaleKPKP(Pos *pos, int strongSide)
 
   int us = strongSide == pos_stm() ? WHITE : BLACK;
 
+  // The KPKP bitbase, if generated, tells whether strongSide wins.
+  Square sq[2] = { psq, normalize(pos, strongSide, square_of(weakSide, PAWN)) };
+  int r = bitbase_probe(BB_KPKP, us, wksq, bksq, sq);
+  if (r >= 0)
+    return r ? SCALE_FACTOR_NONE : SCALE_FACTOR_DRAW;
+
   // If the pawn has advanced to the fifth rank or further, and is not a
   // rook pawn, it is too dangerous to assume that it is at least a draw.
   if (rank_of(psq) >= RANK_5 && file_of(psq) != FILE_A)
@@ -24,9 +24,11 @@
 #include "bitboard.h"
 #include "evaluate.h"
 #include "material.h"
+#include "misc.h"
 #include "pawns.h"
 
-// Trace
+// Terms reported by eval_trace(). Piece types PAWN..KING are used for the
+// terms of the same name.
 
 #define MATERIAL  8
 #define IMBALANCE 9
@@ -37,44 +39,19 @@
 #define TOTAL     14
 #define TERM_NB   15
 
-#if 0
-static double scores[TERM_NB][2][2];
+static Score scores[TERM_NB][2];
 
-INLINE double to_cp(Value v)
+INLINE void trace_add(int idx, Score w, Score b)
 {
-  return ((double)v) / PawnValueEg;
+  scores[idx][WHITE] = w;
+  scores[idx][BLACK] = b;
 }
 
-static void add_c(int idx, int c, Score s) {
-  scores[idx][c][MG] = to_cp(mg_value(s));
-  scores[idx][c][EG] = to_cp(eg_value(s));
-}
-
-static void add(int idx, Score w, Score b) {
-  add(idx, WHITE, w);
-  add(idx, BLACK, b);
-}
-#endif
-
-#if 0
-static void print_term(Term t);
-
-std::ostream& operator<<(std::ostream& os, Term t) {
-
-  if (t == MATERIAL || t == IMBALANCE || t == Term(PAWN) || t == TOTAL)
-      os << "  ---   --- |   ---   --- | ";
-  else
-      os << std::setw(5) << scores[t][WHITE][MG] << " "
-         << std::setw(5) << scores[t][WHITE][EG] << " | "
-         << std::setw(5) << scores[t][BLACK][MG] << " "
-         << std::setw(5) << scores[t][BLACK][EG] << " | ";
-
-  os << std::setw(5) << scores[t][WHITE][MG] - scores[t][BLACK][MG] << " "
-     << std::setw(5) << scores[t][WHITE][EG] - scores[t][BLACK][EG] << " \n";
-
-  return os;
+INLINE void prof_add(EvalProfile *prof, int idx, uint64_t start)
+{
+  prof->cycles[idx] += cpu_cycles() - start;
+  prof->calls[idx]++;
 }
-#endif
 
 // Struct EvalInfo contains various information computed and collected
 // by the evaluation functions.
@@ -273,7 +250,11 @@ INLINE Score evaluate_piece(Pos *pos, EvalInfo *ei, Score *mobility,
     // Find attacked squares, including x-ray attacks for bishops and rooks
     b = Pt == BISHOP ? attacks_bb_bishop(s, pieces() ^ pieces_cp(Us, QUEEN))
       : Pt == ROOK ? attacks_bb_rook(s, pieces() ^ pieces_cpp(Us, ROOK, QUEEN))
+#ifdef ATTACK_MAP
+                   : pos->attacksFrom[s];
+#else
                    : attacks_from(Pt, s);
+#endif
 
     if (ei->pinnedPieces[Us] & sq_bb(s))
       b &= LineBB[square_of(Us, KING)][s];
@@ -359,9 +340,6 @@ INLINE Score evaluate_piece(Pos *pos, EvalInfo *ei, Score *mobility,
     }
   }
 
-//  if (DoTrace)
-//    Trace::add(Pt, Us, score);
-
   return score;
 }
 
@@ -370,16 +348,27 @@ INLINE Score evaluate_piece(Pos *pos, EvalInfo *ei, Score *mobility,
 // evaluate_piece(). No need for C++ templates!
 
 INLINE Score evaluate_pieces(Pos *pos, EvalInfo *ei, Score *mobility,
-                                    Bitboard *mobilityArea)
+                             Bitboard *mobilityArea, const int DoTrace)
 {
-  return  evaluate_piece(pos, ei, mobility, mobilityArea, WHITE, KNIGHT)
-        - evaluate_piece(pos, ei, mobility, mobilityArea, BLACK, KNIGHT)
-        + evaluate_piece(pos, ei, mobility, mobilityArea, WHITE, BISHOP)
-        - evaluate_piece(pos, ei, mobility, mobilityArea, BLACK, BISHOP)
-        + evaluate_piece(pos, ei, mobility, mobilityArea, WHITE, ROOK)
-        - evaluate_piece(pos, ei, mobility, mobilityArea, BLACK, ROOK)
-        + evaluate_piece(pos, ei, mobility, mobilityArea, WHITE, QUEEN)
-        - evaluate_piece(pos, ei, mobility, mobilityArea, BLACK, QUEEN);
+  Score s[2][8];
+
+  s[WHITE][KNIGHT] = evaluate_piece(pos, ei, mobility, mobilityArea, WHITE, KNIGHT);
+  s[BLACK][KNIGHT] = evaluate_piece(pos, ei, mobility, mobilityArea, BLACK, KNIGHT);
+  s[WHITE][BISHOP] = evaluate_piece(pos, ei, mobility, mobilityArea, WHITE, BISHOP);
+  s[BLACK][BISHOP] = evaluate_piece(pos, ei, mobility, mobilityArea, BLACK, BISHOP);
+  s[WHITE][ROOK]   = evaluate_piece(pos, ei, mobility, mobilityArea, WHITE, ROOK);
+  s[BLACK][ROOK]   = evaluate_piece(pos, ei, mobility, mobilityArea, BLACK, ROOK);
+  s[WHITE][QUEEN]  = evaluate_piece(pos, ei, mobility, mobilityArea, WHITE, QUEEN);
+  s[BLACK][QUEEN]  = evaluate_piece(pos, ei, mobility, mobilityArea, BLACK, QUEEN);
+
+  if (DoTrace)
+    for (int pt = KNIGHT; pt <= QUEEN; pt++)
+      trace_add(pt, s[WHITE][pt], s[BLACK][pt]);
+
+  return  s[WHITE][KNIGHT] - s[BLACK][KNIGHT]
+        + s[WHITE][BISHOP] - s[BLACK][BISHOP]
+        + s[WHITE][ROOK]   - s[BLACK][ROOK]
+        + s[WHITE][QUEEN]  - s[BLACK][QUEEN];
 }
 
 
@@ -511,11 +500,6 @@ INLINE Score evaluate_king(Pos *pos, EvalInfo *ei, int Us)
 
   score -= CloseEnemies * popcount(b);
 
-#if 0
-  if (DoTrace)
-    trace_add(KING, Us, score);
-#endif
-
   return score;
 }
 
@@ -597,9 +581,6 @@ INLINE Score evaluate_threats(Pos *pos, EvalInfo *ei, const int Us)
 
   score += ThreatByPawnPush * popcount(b);
 
-//  if (DoTrace)
-//    Trace::add(THREAT, Us, score);
-
   return score;
 }
 
@@ -674,9 +655,6 @@ INLINE Score evaluate_passed_pawns(Pos *pos, EvalInfo *ei,
     score += make_score(mbonus, ebonus) + PassedFile[file_of(s)];
   }
 
-//  if (DoTrace)
-//    Trace::add(PASSED, Us, score);
-
   // Add the scores to the middlegame and endgame eval
   return score;
 }
@@ -778,15 +756,19 @@ INLINE int evaluate_scale_factor(Pos *pos, EvalInfo *ei, Value eg)
 }
 
 
-// evaluate() is the main evaluation function. It returns a static evaluation
-// of the position from the point of view of the side to move.
+// do_evaluate() is the main evaluation function. If prof is not NULL,
+// the individual terms are stored for eval_trace() and the cycles spent
+// in the main evaluation steps are added to *prof. Since do_evaluate() is
+// inlined, evaluate() pays nothing for this.
 
-//template<bool DoTrace>
-Value evaluate(Pos *pos)
+INLINE Value do_evaluate(Pos *pos, EvalProfile *prof)
 {
   assert(!pos_checkers());
 
+  const int DoTrace = prof != NULL;
+  uint64_t t = 0;
   Score mobility[2] = { SCORE_ZERO, SCORE_ZERO };
+  Score w, b;
   EvalInfo ei;
 
   // Probe the material hash table
@@ -807,6 +789,12 @@ Value evaluate(Pos *pos)
   ei.pi = pawn_probe(pos);
   score += ei.pi->score;
 
+  if (DoTrace) {
+    trace_add(MATERIAL, pos_psq_score(), SCORE_ZERO);
+    trace_add(IMBALANCE, material_imbalance(ei.me), SCORE_ZERO);
+    trace_add(PAWN, ei.pi->score, SCORE_ZERO);
+  }
+
   // Initialize attack and king safety bitboards.
   ei.attackedBy[WHITE][0] = ei.attackedBy[BLACK][0] = 0;
   ei.attackedBy[WHITE][KING] = attacks_from_king(square_of(WHITE, KING));
@@ -828,36 +816,66 @@ Value evaluate(Pos *pos)
   };
 
   // Evaluate all pieces but king and pawns
-  score += evaluate_pieces(pos, &ei, mobility, mobilityArea);
+  if (DoTrace) t = cpu_cycles();
+  score += evaluate_pieces(pos, &ei, mobility, mobilityArea, DoTrace);
   score += mobility[WHITE] - mobility[BLACK];
+  if (DoTrace) {
+    prof_add(prof, PROF_PIECES, t);
+    trace_add(MOBILITY, mobility[WHITE], mobility[BLACK]);
+  }
 
   // Evaluate kings after all other pieces because we need full attack
   // information when computing the king safety evaluation.
-  score +=  evaluate_king(pos, &ei, WHITE)
-          - evaluate_king(pos, &ei, BLACK);
+  if (DoTrace) t = cpu_cycles();
+  w = evaluate_king(pos, &ei, WHITE);
+  b = evaluate_king(pos, &ei, BLACK);
+  score += w - b;
+  if (DoTrace) {
+    prof_add(prof, PROF_KING, t);
+    trace_add(KING, w, b);
+  }
 
   // Evaluate tactical threats, we need full attack information including king
-  score +=  evaluate_threats(pos, &ei, WHITE)
-          - evaluate_threats(pos, &ei, BLACK);
+  if (DoTrace) t = cpu_cycles();
+  w = evaluate_threats(pos, &ei, WHITE);
+  b = evaluate_threats(pos, &ei, BLACK);
+  score += w - b;
+  if (DoTrace) {
+    prof_add(prof, PROF_THREATS, t);
+    trace_add(THREAT, w, b);
+  }
 
   // Evaluate passed pawns, we need full attack information including king
-  score +=  evaluate_passed_pawns(pos, &ei, WHITE)
-          - evaluate_passed_pawns(pos, &ei, BLACK);
+  if (DoTrace) t = cpu_cycles();
+  w = evaluate_passed_pawns(pos, &ei, WHITE);
+  b = evaluate_passed_pawns(pos, &ei, BLACK);
+  score += w - b;
+  if (DoTrace) {
+    prof_add(prof, PROF_PASSED, t);
+    trace_add(PASSED, w, b);
+  }
 
   // If both sides have only pawns, score for potential unstoppable pawns
   if (!pos_non_pawn_material(WHITE) && !pos_non_pawn_material(BLACK)) {
-    Bitboard b;
-    if ((b = ei.pi->passedPawns[WHITE]) != 0)
-      score += Unstoppable * relative_rank_s(WHITE, frontmost_sq(WHITE, b));
+    Bitboard bb;
+    if ((bb = ei.pi->passedPawns[WHITE]) != 0)
+      score += Unstoppable * relative_rank_s(WHITE, frontmost_sq(WHITE, bb));
 
-    if ((b = ei.pi->passedPawns[BLACK]) != 0)
-      score -= Unstoppable * relative_rank_s(BLACK, frontmost_sq(BLACK, b));
+    if ((bb = ei.pi->passedPawns[BLACK]) != 0)
+      score -= Unstoppable * relative_rank_s(BLACK, frontmost_sq(BLACK, bb));
   }
 
   // Evaluate space for both sides, only during opening
-  if (pos_non_pawn_material(WHITE) + pos_non_pawn_material(BLACK) >= 12222)
-      score +=  evaluate_space(pos, &ei, WHITE)
-              - evaluate_space(pos, &ei, BLACK);
+  if (pos_non_pawn_material(WHITE) + pos_non_pawn_material(BLACK) >= 12222) {
+    if (DoTrace) t = cpu_cycles();
+    w = evaluate_space(pos, &ei, WHITE);
+    b = evaluate_space(pos, &ei, BLACK);
+    score += w - b;
+    if (DoTrace) {
+      prof_add(prof, PROF_SPACE, t);
+      trace_add(SPACE, w, b);
+    }
+  }
 
   // Evaluate position potential for the winning side
   score += evaluate_initiative(pos, ei.pi->asymmetry, eg_value(score));
@@ -871,57 +889,92 @@ Value evaluate(Pos *pos)
 
   v /= PHASE_MIDGAME;
 
-#if 0
-  // In case of tracing add all remaining individual evaluation terms
   if (DoTrace)
-  {
-      Trace::add(MATERIAL, pos.psq_score());
-      Trace::add(IMBALANCE, ei.me->imbalance());
-      Trace::add(PAWN, ei.pi->pawns_score());
-      Trace::add(MOBILITY, mobility[WHITE], mobility[BLACK]);
-      Trace::add(SPACE, evaluate_space<WHITE>(pos, &ei)
-                      , evaluate_space<BLACK>(pos, &ei));
-      Trace::add(TOTAL, score);
-  }
-#endif
+    trace_add(TOTAL, score, SCORE_ZERO);
 
   return (pos_stm() == WHITE ? v : -v) + Tempo; // Side to move point of view
 }
 
-#if 0
+
+// evaluate() returns a static evaluation of the position from the point
+// of view of the side to move.
+
+Value evaluate(Pos *pos)
+{
+  return do_evaluate(pos, NULL);
+}
+
+
+// eval_profile() is like evaluate(), but adds the cycles spent in each of
+// the main evaluation steps to *prof. Used by the 'evalprof' command.
+
+Value eval_profile(Pos *pos, EvalProfile *prof)
+{
+  return do_evaluate(pos, prof);
+}
+
+
+static void print_term(const char *name, int idx)
+{
+  double w[2], b[2];
+
+  for (int ph = MG; ph <= EG; ph++) {
+    Value vw = ph == MG ? mg_value(scores[idx][WHITE]) : eg_value(scores[idx][WHITE]);
+    Value vb = ph == MG ? mg_value(scores[idx][BLACK]) : eg_value(scores[idx][BLACK]);
+    w[ph] = (double)vw / PawnValueEg;
+    b[ph] = (double)vb / PawnValueEg;
+  }
+
+  printf("%15s | ", name);
+  if (   idx == MATERIAL || idx == IMBALANCE || idx == PAWN
+      || idx == TOTAL)
+    printf("  ---   --- |   ---   --- | ");
+  else
+    printf("%5.2f %5.2f | %5.2f %5.2f | ", w[MG], w[EG], b[MG], b[EG]);
+  printf("%5.2f %5.2f \n", w[MG] - b[MG], w[EG] - b[EG]);
+}
+
 
 // eval_trace() is like evaluate(), but prints the detailed descriptions
 // and values of each evaluation term to stdout. Useful for debugging.
 
 void eval_trace(Pos *pos)
 {
+  if (pos_checkers()) {
+    printf("Total evaluation: none (in check)\n");
+    fflush(stdout);
+    return;
+  }
+
+  EvalProfile prof;
   memset(scores, 0, sizeof(scores));
+  memset(&prof, 0, sizeof(prof));
+
+  Value v = eval_profile(pos, &prof);
+  v = pos_stm() == WHITE ? v : -v; // White's point of view
+
+  if (!prof.calls[PROF_PIECES])
+    printf("Specialized endgame evaluation\n");
+  else {
+    printf("      Eval term |    White    |    Black    |    Total    \n"
+           "                |   MG    EG  |   MG    EG  |   MG    EG  \n"
+           "----------------+-------------+-------------+-------------\n");
+    print_term("Material", MATERIAL);
+    print_term("Imbalance", IMBALANCE);
+    print_term("Pawns", PAWN);
+    print_term("Knights", KNIGHT);
+    print_term("Bishops", BISHOP);
+    print_term("Rooks", ROOK);
+    print_term("Queens", QUEEN);
+    print_term("Mobility", MOBILITY);
+    print_term("King safety", KING);
+    print_term("Threats", THREAT);
+    print_term("Passed pawns", PASSED);
+    print_term("Space", SPACE);
+    printf("----------------+-------------+-------------+-------------\n");
+    print_term("Total", TOTAL);
+  }
 
-  Value v = evaluate<true>(pos);
-  v = pos->stm == WHITE ? v : -v; // White's point of view
-
-  printf("      Eval term |    White    |    Black    |    Total    \n"
-         "                |   MG    EG  |   MG    EG  |   MG    EG  \n"
-         "----------------+-------------+-------------+-------------\n"
-         "       Material | %s"
-         "      Imbalance | %s"
-         "          Pawns | %s"
-         "        Knights | %s"
-         "         Bishop | %s"
-         "          Rooks | %s"
-         "         Queens | %s"
-         "       Mobility | %s"
-         "    King safety | %s"
-         "        Threats | %s"
-         "   Passed pawns | %s"
-         "          Space | %s"
-         "----------------+-------------+-------------+-------------\n"
-         "          Total | %s"
-         Term(MATERIAL), Term(IMBALANCE), Term(PAWN), Term(KNIGHT),
-         Term(BISHOP), Term(ROOK), Term(QUEEN), Term(MOBILITY),
-         Term(KING), Term(THREAT), Term(PASSED), Term(SPACE), Term(TOTAL));
-
-  printf("\nTotal Evaluation: %d (white side)\n", to_cp(v));
+  printf("\nTotal evaluation: %.2f (white side)\n", (double)v / PawnValueEg);
+  fflush(stdout);
 }
-#endif
-
@@ -7,10 +7,19 @@ typedef struct Pos Pos;
 
 #define Tempo ((Value)20)
 
-void trace(Pos *pos);
+// Main evaluation steps timed by eval_profile()
+enum {
+  PROF_PIECES, PROF_KING, PROF_THREATS, PROF_PASSED, PROF_SPACE, PROF_NB
+};
+
+typedef struct {
+  uint64_t cycles[PROF_NB];
+  uint64_t calls[PROF_NB];
+} EvalProfile;
 
-//template<bool DoTrace = false>
 Value evaluate(Pos *pos);
+Value eval_profile(Pos *pos, EvalProfile *prof);
+void eval_trace(Pos *pos);
 
 #endif
 
@@ -22,6 +22,7 @@
 
 #include "bitboard.h"
 #include "endgame.h"
+#include "misc.h"
 #include "pawns.h"
 #include "position.h"
 #include "search.h"
@@ -32,17 +33,40 @@
 
 int main(int argc, char **argv)
 {
+  cpu_init();
+#ifdef USE_DISPATCH
+  if (!Cpu.popcnt) {
+    fprintf(stderr, "This build of Cfish requires a CPU with popcnt.\n");
+    return 1;
+  }
+#endif
+
   print_engine_info(0);
 
-  psqt_init();
-  zob_init();
-  bitboards_init();
-  bitbases_init();
-  search_init();
-  pawn_init();
-  endgames_init();
-  threads_init();
-  options_init();
+  // Time each initialization stage, so that a slow startup can be traced.
+  char stages[256];
+  int len = 0;
+  uint64_t start = now_us(), t = start;
+#define STAGE(f) \
+  do { \
+    f(); \
+    uint64_t t1 = now_us(); \
+    len += sprintf(stages + len, " " #f " %.1f", (t1 - t) / 1000.0); \
+    t = t1; \
+  } while (0)
+
+  STAGE(psqt_init);
+  STAGE(zob_init);
+  STAGE(bitboards_init);
+  STAGE(bitbases_init);
+  STAGE(search_init);
+  STAGE(pawn_init);
+  STAGE(endgames_init);
+  STAGE(threads_init);
+  STAGE(options_init);
+
+  printf("info string Startup in %.1f ms:%s\n", (t - start) / 1000.0, stages);
+  fflush(stdout);
 
   uci_loop(argc, argv);
 
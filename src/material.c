@@ -19,6 +19,7 @@
 */
 
 #include <assert.h>
+#include <stdatomic.h>
 #include <string.h>   // For std::memset
 
 #include "material.h"
@@ -48,26 +49,61 @@ static const int QuadraticTheirs[][8] = {
   { 101,  100, -37,   141,  268,    0 }  // Queen
 };
 
-// Helper used to detect a given material distribution.
-static int is_KXK(Pos *pos, int us)
+// Entries of the shared material table are computed the first time the
+// configuration is probed and published with a single 8-byte store, so
+// startup does not pay for configurations that never occur. Two threads
+// may compute the same entry concurrently, but they store the same value.
+// All other material configurations are rare and go to a small per-thread
+// hash table.
+
+_Alignas(8) MaterialEntry MaterialShared[MATERIAL_SHARED_SIZE];
+
+#define entry_word(e) ((_Atomic uint64_t *)(e))
+
+// Endgame functions referenced by material entries. Indices 1-16 follow
+// endgame_funcs[], index 0 means no function.
+
+EgFunc *const material_funcs[] = {
+  NULL,
+  &EvaluateKPK, &EvaluateKNNK, &EvaluateKBNK, &EvaluateKRKP,
+  &EvaluateKRKB, &EvaluateKRKN, &EvaluateKQKP, &EvaluateKQKR,
+  &ScaleKNPK, &ScaleKNPKB, &ScaleKRPKR, &ScaleKRPKB,
+  &ScaleKBPKB, &ScaleKBPKN, &ScaleKBPPKB, &ScaleKRPPKRP,
+  &EvaluateKXK, &ScaleKBPsK, &ScaleKQKRPs, &ScaleKPsK, &ScaleKPKP
+};
+
+enum {
+  FUNC_KXK = NUM_EVAL + NUM_SCALING + 1,
+  FUNC_KBPSK, FUNC_KQKRPS, FUNC_KPSK, FUNC_KPKP
+};
+
+extern Key mat_key[16];
+
+#define count_of(key,c,p) (((key) >> (20 * (c) + 4 * (p) + 4)) & 15)
+
+// Helpers used to detect a given material distribution. They only look at
+// the piece counts, so that entries can be computed without a position.
+static int is_KXK(int pc[][8], Value npm[], int us)
 {
-  return  !more_than_one(pieces_c(us ^ 1))
-        && pos_non_pawn_material(us) >= RookValueMg;
+  int them = us ^ 1;
+  return   !(pc[them][PAWN] | pc[them][KNIGHT] | pc[them][BISHOP]
+             | pc[them][ROOK] | pc[them][QUEEN])
+        && npm[us] >= RookValueMg;
 }
 
-static int is_KBPsKs(Pos *pos, int us)
+static int is_KBPsKs(int pc[][8], Value npm[], int us)
 {
-  return   pos_non_pawn_material(us) == BishopValueMg
-        && pieces_cp(us, BISHOP)
-        && pieces_cp(us, PAWN);
+  return   npm[us] == BishopValueMg
+        && pc[us][BISHOP]
+        && pc[us][PAWN];
 }
 
-static int is_KQKRPs(Pos *pos, int us) {
-  return  !piece_count(us, PAWN)
-        && pos_non_pawn_material(us) == QueenValueMg
-        && pieces_cp(us, QUEEN)
-        && piece_count(us ^ 1, ROOK) == 1
-        && pieces_cp(us ^ 1, PAWN);
+static int is_KQKRPs(int pc[][8], Value npm[], int us) {
+  return  !pc[us][PAWN]
+        && npm[us] == QueenValueMg
+        && pc[us][QUEEN]
+        && pc[us ^ 1][ROOK] == 1
+        && pc[us ^ 1][PAWN];
 }
 
 // imbalance() calculates the imbalance by comparing the piece count of each
@@ -95,44 +131,45 @@ int imbalance(int us, int pieceCount[][8])
   return bonus;
 }
 
-typedef int PieceCountType[2][8];
-
-// material_probe() looks up the current position's material configuration
-// in the material hash table. It returns a pointer to the MaterialEntry
-// if the position is found. Otherwise a new Entry is computed and stored
-// there, so we don't have to recompute all when the same material
-// configuration occurs again.
+// material_entry_init() computes the MaterialEntry for the material
+// configuration encoded in the given material key.
 
-MaterialEntry *material_probe(Pos *pos)
+static void material_entry_init(MaterialEntry *e, Key key)
 {
-  Key key = pos_material_key();
-//  MaterialEntry *e = &pos->materialTable[(key * 0xb44cede0e4473d6dULL) >> (64 - 13)];
-  MaterialEntry *e = &pos->materialTable[key >> (64 - 13)];
+  int pc[2][8];
+  Value npm[2];
 
-  if (e->key == key)
-      return e;
+  for (int c = 0; c < 2; c++) {
+    npm[c] = 0;
+    for (int pt = PAWN; pt <= QUEEN; pt++) {
+      pc[c][pt] = count_of(key, c, pt);
+      if (pt != PAWN)
+        npm[c] += pc[c][pt] * PieceValue[MG][pt];
+    }
+  }
 
   memset(e, 0, sizeof(MaterialEntry));
-  e->key = key;
+  e->eval_func = EVAL_FUNC_NONE;
   e->factor[WHITE] = e->factor[BLACK] = (uint8_t)SCALE_FACTOR_NORMAL;
-  e->gamePhase = game_phase(pos);
+
+  Value npm_all = min(MidgameLimit, max(EndgameLimit, npm[WHITE] + npm[BLACK]));
+  e->gamePhase = (uint8_t)(((npm_all - EndgameLimit) * PHASE_MIDGAME) / (MidgameLimit - EndgameLimit));
 
   // Look for a specialized evaluation function.
   for (int i = 0; i < NUM_EVAL; i++) {
     struct EndgameFunc *ef = &endgame_funcs[i];
     for (int c = 0; c < 2; c++)
       if (ef->key[c] == key) {
-	e->eval_func = ef->eg_func;
-	e->eval_func_side = c;
-	return e;
+        assert(material_funcs[i + 1] == ef->eg_func);
+        e->eval_func = (uint8_t)((i + 1) << 1 | c);
+        return;
       }
   }
 
   for (int c = 0; c < 2; c++)
-    if (is_KXK(pos, c)) {
-      e->eval_func = &EvaluateKXK;
-      e->eval_func_side = c;
-      return e;
+    if (is_KXK(pc, npm, c)) {
+      e->eval_func = (uint8_t)(FUNC_KXK << 1 | c);
+      return;
     }
 
   // Look for a specialized scaling function.
@@ -140,8 +177,9 @@ MaterialEntry *material_probe(Pos *pos)
     struct EndgameFunc *ef = &endgame_funcs[NUM_EVAL + i];
     for (int c = 0; c < 2; c++)
       if (ef->key[c] == key) {
-        e->scal_func[c] = ef->eg_func;
-        return e;
+        assert(material_funcs[NUM_EVAL + i + 1] == ef->eg_func);
+        e->scal_func[c] = (uint8_t)(NUM_EVAL + i + 1);
+        return;
       }
   }
 
@@ -149,32 +187,32 @@ MaterialEntry *material_probe(Pos *pos)
   // generic ones that refer to more than one material distribution. Note
   // that in this case we do not return after setting the function.
   for (int c = 0; c < 2; c++) {
-    if (is_KBPsKs(pos, c))
-      e->scal_func[c] = &ScaleKBPsK;
+    if (is_KBPsKs(pc, npm, c))
+      e->scal_func[c] = FUNC_KBPSK;
 
-    else if (is_KQKRPs(pos, c))
-      e->scal_func[c] = &ScaleKQKRPs;
+    else if (is_KQKRPs(pc, npm, c))
+      e->scal_func[c] = FUNC_KQKRPS;
   }
 
-  Value npm_w = pos_non_pawn_material(WHITE);
-  Value npm_b = pos_non_pawn_material(BLACK);
+  Value npm_w = npm[WHITE];
+  Value npm_b = npm[BLACK];
 
-  if (npm_w + npm_b == 0 && pieces_p(PAWN)) { // Only pawns on the board.
-    if (!pieces_cp(BLACK, PAWN)) {
-      assert(piece_count(WHITE, PAWN) >= 2);
+  if (npm_w + npm_b == 0 && (pc[WHITE][PAWN] || pc[BLACK][PAWN])) { // Only pawns on the board.
+    if (!pc[BLACK][PAWN]) {
+      assert(pc[WHITE][PAWN] >= 2);
 
-      e->scal_func[WHITE] = &ScaleKPsK;
+      e->scal_func[WHITE] = FUNC_KPSK;
     }
-    else if (!pieces_cp(WHITE, PAWN)) {
-      assert(piece_count(BLACK, PAWN) >= 2);
+    else if (!pc[WHITE][PAWN]) {
+      assert(pc[BLACK][PAWN] >= 2);
 
-      e->scal_func[BLACK] = &ScaleKPsK;
+      e->scal_func[BLACK] = FUNC_KPSK;
     }
-    else if (popcount(pieces_p(PAWN)) == 2) { // Each side has one pawn.
+    else if (pc[WHITE][PAWN] + pc[BLACK][PAWN] == 2) { // Each side has one pawn.
       // This is a special case because we set scaling functions
       // for both colors instead of only one.
-      e->scal_func[WHITE] = &ScaleKPKP;
-      e->scal_func[BLACK] = &ScaleKPKP;
+      e->scal_func[WHITE] = FUNC_KPKP;
+      e->scal_func[BLACK] = FUNC_KPKP;
     }
   }
 
@@ -182,33 +220,63 @@ MaterialEntry *material_probe(Pos *pos)
   // material advantage. This catches some trivial draws like KK, KBK and
   // KNK and gives a drawish scale factor for cases such as KRKBP and
   // KmmKm (except for KBBKN).
-  if (!piece_count(WHITE, PAWN) && npm_w - npm_b <= BishopValueMg)
+  if (!pc[WHITE][PAWN] && npm_w - npm_b <= BishopValueMg)
     e->factor[WHITE] = (uint8_t)(npm_w <  RookValueMg   ? SCALE_FACTOR_DRAW :
                                  npm_b <= BishopValueMg ? 4 : 14);
 
-  if (!piece_count(BLACK, PAWN) && npm_b - npm_w <= BishopValueMg)
+  if (!pc[BLACK][PAWN] && npm_b - npm_w <= BishopValueMg)
     e->factor[BLACK] = (uint8_t)(npm_b <  RookValueMg   ? SCALE_FACTOR_DRAW :
                                  npm_w <= BishopValueMg ? 4 : 14);
 
-  if (piece_count(WHITE, PAWN) == 1 && npm_w - npm_b <= BishopValueMg)
+  if (pc[WHITE][PAWN] == 1 && npm_w - npm_b <= BishopValueMg)
     e->factor[WHITE] = (uint8_t)SCALE_FACTOR_ONEPAWN;
 
-  if (piece_count(BLACK, PAWN) == 1 && npm_b - npm_w <= BishopValueMg)
+  if (pc[BLACK][PAWN] == 1 && npm_b - npm_w <= BishopValueMg)
     e->factor[BLACK] = (uint8_t)SCALE_FACTOR_ONEPAWN;
 
   // Evaluate the material imbalance. We use PIECE_TYPE_NONE as a place
   // holder for the bishop pair "extended piece", which allows us to be
   // more flexible in defining bishop pair bonuses.
-#define pc(c,p) piece_count_mk(c,p)
   int PieceCount[2][8] = {
-    { pc(0, BISHOP) > 1, pc(0, PAWN), pc(0, KNIGHT),
-      pc(0, BISHOP)    , pc(0, ROOK), pc(0, QUEEN) },
-    { pc(1, BISHOP) > 1, pc(1, PAWN), pc(1, KNIGHT),
-      pc(1, BISHOP)    , pc(1, ROOK), pc(1, QUEEN) }
+    { pc[0][BISHOP] > 1, pc[0][PAWN], pc[0][KNIGHT],
+      pc[0][BISHOP]    , pc[0][ROOK], pc[0][QUEEN] },
+    { pc[1][BISHOP] > 1, pc[1][PAWN], pc[1][KNIGHT],
+      pc[1][BISHOP]    , pc[1][ROOK], pc[1][QUEEN] }
   };
-#undef pc
   e->value = (int16_t)((imbalance(WHITE, PieceCount) - imbalance(BLACK, PieceCount)) / 16);
-
-  return e;
 }
 
+
+// material_probe() looks up the current position's material configuration.
+// Common configurations are found in the shared table, where they are
+// computed on first use. Otherwise we look in the per-thread material hash
+// table, and if the entry is not found a new one is computed and stored
+// there, so we don't have to recompute all when the same material
+// configuration occurs again.
+
+MaterialEntry *material_probe(Pos *pos)
+{
+  Key key = pos_material_key();
+  unsigned idx = material_index(key);
+
+  if (idx != MATERIAL_NONE) {
+    MaterialEntry *e = &MaterialShared[idx];
+    if (!atomic_load_explicit(entry_word(e), memory_order_relaxed)) {
+      MaterialEntry tmp;
+      uint64_t w;
+      material_entry_init(&tmp, key);
+      memcpy(&w, &tmp, sizeof(w));
+      atomic_store_explicit(entry_word(e), w, memory_order_relaxed);
+    }
+    return e;
+  }
+
+  MaterialHashEntry *he = &pos->materialTable[key >> (64 - 10)];
+
+  if (he->key != key) {
+    he->key = key;
+    material_entry_init(&he->entry, key);
+  }
+
+  return &he->entry;
+}
@@ -28,10 +28,11 @@
 typedef struct Pos Pos;
 
 // MaterialEntry contains various information about a material
-// configuration. It contains a material imbalance evaluation, a function
-// pointer to a special endgame evaluation function (which in most cases
-// is NULL, meaning that the standard evaluation function will be used),
-// and scale factors.
+// configuration. It contains a material imbalance evaluation, the index of
+// a special endgame evaluation function (which in most cases is
+// EVAL_FUNC_NONE, meaning that the standard evaluation function will be
+// used), and scale factors. Endgame functions are stored as byte indices
+// into material_funcs[] so that an entry fits in 8 bytes.
 //
 // The scale factors are used to scale the evaluation score up or down.
 // For instance, in KRB vs KR endgames, the score is scaled down by a
@@ -39,17 +40,19 @@ typedef struct Pos Pos;
 // one pawn.
 
 struct MaterialEntry {
-  Key key;
-  Value (*eval_func)(Pos *, int);
-  Value (*scal_func[2])(Pos *, int);
-  int gamePhase;
   int16_t value;
+  uint8_t gamePhase;
   uint8_t factor[2];
-  uint8_t eval_func_side;
+  uint8_t eval_func;    // function index << 1 | strong side, 0 if not computed
+  uint8_t scal_func[2]; // function index, 0 if none
 };
 
 typedef struct MaterialEntry MaterialEntry;
 
+#define EVAL_FUNC_NONE 1
+
+extern EgFunc *const material_funcs[];
+
 INLINE Score material_imbalance(MaterialEntry *me)
 {
   return make_score((unsigned)me->value, me->value);
@@ -57,12 +60,12 @@ INLINE Score material_imbalance(MaterialEntry *me)
 
 INLINE int material_specialized_eval_exists(MaterialEntry *me)
 {
-  return me->eval_func != NULL;
+  return me->eval_func != EVAL_FUNC_NONE;
 }
 
 INLINE Value material_evaluate(MaterialEntry *me, Pos *pos)
 {
-  return me->eval_func(pos, me->eval_func_side);
+  return material_funcs[me->eval_func >> 1](pos, me->eval_func & 1);
 }
 
 // scale_factor takes a position and a color as input and returns a scale factor
@@ -74,11 +77,57 @@ INLINE int material_scale_factor(MaterialEntry *me, Pos *pos, int c)
 {
   int sf = SCALE_FACTOR_NONE;
   if (me->scal_func[c])
-    sf = me->scal_func[c](pos, c);
+    sf = material_funcs[me->scal_func[c]](pos, c);
   return sf != SCALE_FACTOR_NONE ? sf : me->factor[c];
 }
 
-typedef MaterialEntry MaterialTable[8192];
+struct MaterialHashEntry {
+  Key key;
+  MaterialEntry entry;
+};
+
+typedef struct MaterialHashEntry MaterialHashEntry;
+
+typedef MaterialHashEntry MaterialTable[1024];
+
+// Material configurations with at most 8 pawns, 2 knights, 2 bishops,
+// 2 rooks and 1 queen per side have a slot in a table shared by all
+// threads. The index is a perfect hash of the piece counts, which the
+// material key stores in its lower bits.
+
+#define MATERIAL_SHARED_SIZE (9 * 3 * 3 * 3 * 2 * 9 * 3 * 3 * 3 * 2)
+#define MATERIAL_NONE        MATERIAL_SHARED_SIZE
+
+extern MaterialEntry MaterialShared[MATERIAL_SHARED_SIZE];
+
+// material_index() returns the index of the given material configuration
+// in the shared table, or MATERIAL_NONE if it is not covered.
+
+INLINE unsigned material_index(Key key)
+{
+  unsigned idx = 0;
+
+  for (int c = 0; c < 2; c++)
+    for (int pt = PAWN; pt <= QUEEN; pt++) {
+      unsigned max = pt == PAWN ? 8 : pt == QUEEN ? 1 : 2;
+      unsigned n = (key >> (20 * c + 4 * pt + 4)) & 15;
+      if (n > max)
+        return MATERIAL_NONE;
+      idx = idx * (max + 1) + n;
+    }
+
+  return idx;
+}
+
+INLINE void material_prefetch(MaterialHashEntry *table, Key key)
+{
+  unsigned idx = material_index(key);
+
+  if (idx != MATERIAL_NONE)
+    prefetch(&MaterialShared[idx]);
+  else
+    prefetch(&table[key >> (64 - 10)]);
+}
 
 MaterialEntry *material_probe(Pos *pos);
 
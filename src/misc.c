@@ -24,6 +24,10 @@
 #ifdef __WIN32__
 #include <windows.h>
 #endif
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <cpuid.h>
+#define HAS_CPUID
+#endif
 
 #include "misc.h"
 #include "thread.h"
@@ -132,6 +136,69 @@ void print_engine_info(int to_uci)
 }
 
 
+CpuFeatures Cpu;
+
+// cpu_init() detects the instruction set extensions of the processor we
+// are running on and stores them in Cpu. AVX2 is only reported if the OS
+// saves the YMM registers on context switches.
+
+void cpu_init(void)
+{
+#ifdef HAS_CPUID
+  unsigned eax = 0, ebx = 0, ecx = 0, edx = 0, maxLeaf;
+  char vendor[13];
+
+  if (!__get_cpuid(0, &maxLeaf, &ebx, &ecx, &edx))
+    return;
+  memcpy(vendor, &ebx, 4);
+  memcpy(vendor + 4, &edx, 4);
+  memcpy(vendor + 8, &ecx, 4);
+  vendor[12] = 0;
+
+  __get_cpuid(1, &eax, &ebx, &ecx, &edx);
+  int family = (eax >> 8) & 0xf;
+  if (family == 0xf)
+    family += (eax >> 20) & 0xff;
+  Cpu.popcnt = !!(ecx & bit_POPCNT);
+
+  int osAvx = 0;
+  if ((ecx & bit_OSXSAVE) && (ecx & bit_AVX)) {
+    unsigned lo, hi;
+    __asm__ __volatile__ ("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    osAvx = (lo & 6) == 6;
+  }
+
+  if (maxLeaf >= 7) {
+    __cpuid_count(7, 0, eax, ebx, ecx, edx);
+    Cpu.bmi2 = !!(ebx & bit_BMI2);
+    Cpu.avx2 = osAvx && (ebx & bit_AVX2);
+  }
+
+  // pext and pdep are microcoded and very slow on Zen 1 and Zen 2
+  int amd =   strcmp(vendor, "AuthenticAMD") == 0
+           || strcmp(vendor, "HygonGenuine") == 0;
+  Cpu.fastPext = Cpu.bmi2 && !(amd && family < 0x19);
+#endif
+}
+
+
+// cpu_features() writes the detected instruction set extensions to str.
+
+char *cpu_features(char *str)
+{
+  sprintf(str, "%s%s%s%s", Cpu.popcnt ? "popcnt " : "",
+          Cpu.bmi2 ? (Cpu.fastPext ? "bmi2 " : "bmi2(slow pext) ") : "",
+          Cpu.avx2 ? "avx2 " : "",
+          Cpu.popcnt || Cpu.bmi2 || Cpu.avx2 ? "" : "none");
+
+  size_t len = strlen(str);
+  if (len && str[len - 1] == ' ')
+    str[len - 1] = 0;
+
+  return str;
+}
+
+
 // Debug functions used mainly to collect run-time statistics
 static int64_t hits[2], means[2];
 
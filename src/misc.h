@@ -28,6 +28,10 @@
 #endif
 #include <stdatomic.h>
 #include <sys/time.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
 
 #include "types.h"
 
@@ -55,6 +59,19 @@ INLINE void prefetch(void *addr)
 #endif
 }
 
+// CpuFeatures holds the instruction set extensions found by cpu_init().
+// fastPext is set on CPUs with BMI2 where pext is not microcoded (all
+// except AMD/Hygon processors before Zen 3).
+
+typedef struct {
+  int popcnt, bmi2, fastPext, avx2;
+} CpuFeatures;
+
+extern CpuFeatures Cpu;
+
+void cpu_init(void);
+char *cpu_features(char *str);
+
 void start_logger(const char *fname);
 
 void dbg_hit_on(int b);
@@ -70,6 +87,29 @@ INLINE TimePoint now() {
   return 1000 * (uint64_t)tv.tv_sec + (uint64_t)tv.tv_usec / 1000;
 }
 
+// now_us() returns the time in microseconds, for timing short tasks.
+
+INLINE uint64_t now_us(void) {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return 1000000 * (uint64_t)tv.tv_sec + (uint64_t)tv.tv_usec;
+}
+
+// cpu_cycles() reads the processor's time stamp counter. On other
+// architectures it falls back to a nanosecond clock. Only differences
+// between two readings on the same thread are meaningful.
+
+INLINE uint64_t cpu_cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return 1000000000 * (uint64_t)ts.tv_sec + (uint64_t)ts.tv_nsec;
+#endif
+}
+
 #ifndef __WIN32__
 extern pthread_mutex_t io_mutex;
 #define IO_LOCK   pthread_mutex_lock(&io_mutex)
@@ -18,746 +18,500 @@
   along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
-#if 1
-#include "movegen2.c"
-#else
 #include <assert.h>
 
 #include "movegen.h"
 #include "position.h"
+#include "types.h"
 
-static int free_path(Pos *pos, int from, int to, Bitboard enemies)
-{
-  int d = from > to ? 1 : -1;
-
-  for (int s = to; s != from; s += d)
-    if (attackers_to(s) & enemies)
-      return 0;
+// The generators below take the side to move (Us) and the generation type
+// (one of the GEN_* constants) as compile-time constants. Every exported
+// generator calls them with literal values, so each color and type gets
+// its own fully specialized code.
 
-  return 1;
-}
-
-// FIXME: squares to be checked can be pregenerated.
-// Idem for the castling moves themselves.
-// instead of special chess960, check for unpinned rook?
-static ExtMove *gen_castling_white(Pos *pos, ExtMove *list)
+INLINE ExtMove *generate_castling(Pos *pos, ExtMove *list, int us,
+                                  const int Cr, const int Checks,
+                                  const int Chess960)
 {
-  if (can_castle_cr(WHITE_OO) && !castling_impeded(WHITE_OO)) {
-    Square kfrom = square_of(WHITE, KING);
-    if (free_path(pos, kfrom, SQ_G1, pieces_c(BLACK))) {
-      Square rfrom = castling_rook_square(WHITE_OO);
-      (list++)->move = make_castling(kfrom, rfrom);
-    }
-  }
-  if (can_castle_cr(WHITE_OOO) && !castling_impeded(WHITE_OOO)) {
-    Square kfrom = square_of(WHITE, KING);
-    if (free_path(pos, kfrom, SQ_C1, pieces_c(BLACK)) && (!is_chess960()
-                       || !(pieces_cpp(BLACK, ROOK, QUEEN) & sq_bb(SQ_A1)))) {
-      Square rfrom = castling_rook_square(WHITE_OOO);
-      (list++)->move = make_castling(kfrom, rfrom);
-    }
-  }
+  const int KingSide = (Cr == WHITE_OO || Cr == BLACK_OO);
 
-  return list;
-}
+  if (castling_impeded(Cr) || !can_castle_cr(Cr))
+    return list;
 
-static ExtMove *gen_castling_black(Pos *pos, ExtMove *list)
-{
-  if (can_castle_cr(BLACK_OO) && !castling_impeded(BLACK_OO)) {
-    Square kfrom = square_of(BLACK, KING);
-    if (free_path(pos, kfrom, SQ_G8, pieces_c(WHITE))) {
-      Square rfrom = castling_rook_square(BLACK_OO);
-      (list++)->move = make_castling(kfrom, rfrom);
-    }
-  }
-  if (can_castle_cr(BLACK_OOO) && !castling_impeded(BLACK_OOO)) {
-    Square kfrom = square_of(BLACK, KING);
-    if (free_path(pos, kfrom, SQ_C8, pieces_c(WHITE)) && (!is_chess960()
-                       || !(pieces_cpp(WHITE, ROOK, QUEEN) & sq_bb(SQ_A8)))) {
-      Square rfrom = castling_rook_square(BLACK_OOO);
-      (list++)->move = make_castling(kfrom, rfrom);
-    }
-  }
+  // After castling, the rook and king final positions are the same in Chess960
+  // as they would be in standard chess.
+  Square kfrom = square_of(us, KING);
+  Square rfrom = castling_rook_square(Cr);
+  Square kto = relative_square(us, KingSide ? SQ_G1 : SQ_C1);
+  Bitboard enemies = pieces_c(us ^ 1);
 
-  return list;
-}
-
-static ExtMove *gen_pawn_pushes_white(Pos *pos, ExtMove *list)
-{
-  Bitboard pawns, b1, b2, empty;
+  assert(!pos_checkers());
 
-  pawns = pieces_cp(WHITE, PAWN);
-  empty = ~pieces();
+  const int K = Chess960 ? kto > kfrom ? DELTA_W : DELTA_E
+                         : KingSide    ? DELTA_W : DELTA_E;
 
-  // Single and double regular pushes.
-  b1 = shift_bb_N(pawns & ~Rank7BB) & empty;
-  b2 = shift_bb_N(b1 & Rank3BB) & empty;
-  while (b1) {
-    Square to = pop_lsb(&b1);
-    (list++)->move = make_move(to - DELTA_N, to);
-  }
-  while (b2) {
-    Square to = pop_lsb(&b2);
-    (list++)->move = make_move(to - DELTA_NN, to);
-  }
+  for (Square s = kto; s != kfrom; s += K)
+    if (attackers_to(s) & enemies)
+      return list;
 
-  // Underpromotions.
-  if (pawns & Rank7BB) {
-    b1 = shift_bb_NE(pawns & Rank7BB) & pieces_c(BLACK);
-    while (b1) {
-      Square to = pop_lsb(&b1);
-      (list++)->move = make_promotion(to - DELTA_NE, to, ROOK);
-      (list++)->move = make_promotion(to - DELTA_NE, to, BISHOP);
-      (list++)->move = make_promotion(to - DELTA_NE, to, KNIGHT);
-    }
+  // Because we generate only legal castling moves we need to verify that
+  // when moving the castling rook we do not discover some hidden checker.
+  // For instance an enemy queen in SQ_A1 when castling rook is in SQ_B1.
+  if (Chess960 && (attacks_bb_rook(kto, pieces() ^ sq_bb(rfrom))
+                                   & pieces_cpp(us ^ 1, ROOK, QUEEN)))
+    return list;
 
-    b1 = shift_bb_NW(pawns & Rank7BB) & pieces_c(BLACK);
-    while (b1) {
-      Square to = pop_lsb(&b1);
-      (list++)->move = make_promotion(to - DELTA_NW, to, ROOK);
-      (list++)->move = make_promotion(to - DELTA_NW, to, BISHOP);
-      (list++)->move = make_promotion(to - DELTA_NW, to, KNIGHT);
-    }
+  Move m = make_castling(kfrom, rfrom);
 
-    b1 = shift_bb_N(pawns & Rank7BB) & empty;
-    while (b1) {
-      Square to = pop_lsb(&b1);
-      (list++)->move = make_promotion(to - DELTA_N, to, ROOK);
-      (list++)->move = make_promotion(to - DELTA_N, to, BISHOP);
-      (list++)->move = make_promotion(to - DELTA_N, to, KNIGHT);
-    }
-  }
+  if (Checks && !gives_check(pos, pos->st, m))
+    return list;
 
+  (list++)->move = m;
   return list;
 }
 
-static ExtMove *gen_pawn_pushes_black(Pos *pos, ExtMove *list)
-{
-  Bitboard pawns, b1, b2, empty;
 
-  pawns = pieces_cp(BLACK, PAWN);
-  empty = ~pieces();
+INLINE ExtMove *make_promotions(ExtMove *list, Square to, Square ksq,
+                                const int Type, const int Delta)
+{
+  if (   Type == GEN_CAPTURES || Type == GEN_EVASIONS
+      || Type == GEN_NON_EVASIONS || Type == GEN_LEGAL)
+    (list++)->move = make_promotion(to - Delta, to, QUEEN);
 
-  // Single and double regular pushes.
-  b1 = shift_bb_S(pawns & ~Rank2BB) & empty;
-  b2 = shift_bb_S(b1 & Rank6BB) & empty;
-  while (b1) {
-    Square to = pop_lsb(&b1);
-    (list++)->move = make_move(to - DELTA_S, to);
-  }
-  while (b2) {
-    Square to = pop_lsb(&b2);
-    (list++)->move = make_move(to - DELTA_SS, to);
+  if (   Type == GEN_QUIETS || Type == GEN_EVASIONS
+      || Type == GEN_NON_EVASIONS || Type == GEN_LEGAL) {
+    (list++)->move = make_promotion(to - Delta, to, ROOK);
+    (list++)->move = make_promotion(to - Delta, to, BISHOP);
+    (list++)->move = make_promotion(to - Delta, to, KNIGHT);
   }
 
-  // Underpromotions.
-  if (pawns & Rank2BB) {
-    b1 = shift_bb_SW(pawns & Rank2BB) & pieces_c(WHITE);
-    while (b1) {
-      Square to = pop_lsb(&b1);
-      (list++)->move = make_promotion(to - DELTA_SW, to, ROOK);
-      (list++)->move = make_promotion(to - DELTA_SW, to, BISHOP);
-      (list++)->move = make_promotion(to - DELTA_SW, to, KNIGHT);
-    }
-
-    b1 = shift_bb_SE(pawns & Rank2BB) & pieces_c(WHITE);
-    while (b1) {
-      Square to = pop_lsb(&b1);
-      (list++)->move = make_promotion(to - DELTA_SE, to, ROOK);
-      (list++)->move = make_promotion(to - DELTA_SE, to, BISHOP);
-      (list++)->move = make_promotion(to - DELTA_SE, to, KNIGHT);
-    }
-
-    b1 = shift_bb_S(pawns & Rank2BB) & empty;
-    while (b1) {
-      Square to = pop_lsb(&b1);
-      (list++)->move = make_promotion(to - DELTA_S, to, ROOK);
-      (list++)->move = make_promotion(to - DELTA_S, to, BISHOP);
-      (list++)->move = make_promotion(to - DELTA_S, to, KNIGHT);
-    }
-  }
+  // Knight promotion is the only promotion that can give a direct check
+  // that's not already included in the queen promotion.
+  if (   Type == GEN_QUIET_CHECKS
+      && (StepAttacksBB[W_KNIGHT][to] & sq_bb(ksq)))
+    (list++)->move = make_promotion(to - Delta, to, KNIGHT);
 
   return list;
 }
 
-static ExtMove *gen_pawn_captures_white(Pos *pos, ExtMove *list)
-{
-  Bitboard pawns, target, b1;
-
-  pawns = pieces_cp(WHITE, PAWN);
-  target = pieces_c(BLACK);
-
-  // Queen promotions.
-  if (pawns & Rank7BB) {
-    b1 = shift_bb_NE(pawns & Rank7BB) & target;
-    while (b1) {
-      Square to = pop_lsb(&b1);
-      (list++)->move = make_promotion(to - DELTA_NE, to, QUEEN);
-    }
 
-    b1 = shift_bb_NW(pawns & Rank7BB) & target;
-    while (b1) {
-      Square to = pop_lsb(&b1);
-      (list++)->move = make_promotion(to - DELTA_NW, to, QUEEN);
-    }
+// generate_pawn_moves() generates the moves of the given pawns. With
+// GEN_LEGAL, the pawns are not pinned or are passed one at a time with
+// target restricted to their pin ray, and target also holds the check
+// mask. Like GEN_EVASIONS, all moves then stay within target, but en
+// passant captures are left to the caller.
 
-    b1 = shift_bb_N(pawns & Rank7BB) & ~pieces();
-    while (b1) {
-      Square to = pop_lsb(&b1);
-      (list++)->move = make_promotion(to - DELTA_N, to, QUEEN);
-    }
-  }
+INLINE ExtMove *generate_pawn_moves(Pos *pos, ExtMove *list, Bitboard pawns,
+                                    Bitboard target, const int Us,
+                                    const int Type)
+{
+  // Compute our parametrized parameters at compile time, named according to
+  // the point of view of white side.
+  const int      Them     = (Us == WHITE ? BLACK    : WHITE);
+  const Bitboard TRank8BB = (Us == WHITE ? Rank8BB  : Rank1BB);
+  const Bitboard TRank7BB = (Us == WHITE ? Rank7BB  : Rank2BB);
+  const Bitboard TRank3BB = (Us == WHITE ? Rank3BB  : Rank6BB);
+  const int      Up       = (Us == WHITE ? DELTA_N  : DELTA_S);
+  const int      Right    = (Us == WHITE ? DELTA_NE : DELTA_SW);
+  const int      Left     = (Us == WHITE ? DELTA_NW : DELTA_SE);
 
-  // Regular pawn captures.
-  b1 = shift_bb_NE(pawns & ~Rank7BB) & target;
-  while (b1) {
-    Square to = pop_lsb(&b1);
-    (list++)->move = make_move(to - DELTA_NE, to);
-  }
+  Bitboard emptySquares;
 
-  b1 = shift_bb_NW(pawns & ~Rank7BB) & target;
-  while (b1) {
-    Square to = pop_lsb(&b1);
-    (list++)->move = make_move(to - DELTA_NW, to);
-  }
+  // Evasions and legal moves must stay within target
+  const int Masked = (Type == GEN_EVASIONS || Type == GEN_LEGAL);
 
-  // En passant.
-  if (ep_square() != 0) {
-     assert(rank_of(ep_square()) == relative_rank(WHITE, RANK_6));
+  Bitboard pawnsOn7    = pawns &  TRank7BB;
+  Bitboard pawnsNotOn7 = pawns & ~TRank7BB;
 
-     b1 = pawns & attacks_from_pawn(ep_square(), BLACK);
+  Bitboard enemies = (Masked               ? pieces_c(Them) & target:
+                      Type == GEN_CAPTURES ? target : pieces_c(Them));
 
-     assert(b1);
+  // Single and double pawn pushes, no promotions
+  if (Type != GEN_CAPTURES) {
+    emptySquares = (  Type == GEN_QUIETS || Type == GEN_QUIET_CHECKS
+                    ? target : ~pieces());
 
-     while (b1)
-       (list++)->move = make_enpassant(pop_lsb(&b1), ep_square());
-  }
+    Bitboard b1 = shift_bb(Up, pawnsNotOn7)   & emptySquares;
+    Bitboard b2 = shift_bb(Up, b1 & TRank3BB) & emptySquares;
 
-  return list;
-}
+    if (Masked) { // Consider only blocking squares
+      b1 &= target;
+      b2 &= target;
+    }
 
-static ExtMove *gen_pawn_captures_black(Pos *pos, ExtMove *list)
-{
-  Bitboard pawns, target, b1;
+    if (Type == GEN_QUIET_CHECKS) {
+      Stack *st = pos->st;
+      b1 &= attacks_from_pawn(st->ksq, Them);
+      b2 &= attacks_from_pawn(st->ksq, Them);
 
-  pawns = pieces_cp(BLACK, PAWN);
-  target = pieces_c(WHITE);
+      // Add pawn pushes which give discovered check. This is possible only
+      // if the pawn is not on the same file as the enemy king, because we
+      // don't generate captures. Note that a possible discovery check
+      // promotion has been already generated amongst the captures.
+      Bitboard dcCandidates = blockers_for_king(pos, Them);
+      if (pawnsNotOn7 & dcCandidates) {
+        Bitboard dc1 = shift_bb(Up, pawnsNotOn7 & dcCandidates) & emptySquares & ~file_bb_s(st->ksq);
+        Bitboard dc2 = shift_bb(Up, dc1 & TRank3BB) & emptySquares;
 
-  // Queen promotions.
-  if (pawns & Rank2BB) {
-    b1 = shift_bb_SW(pawns & Rank2BB) & target;
-    while (b1) {
-      Square to = pop_lsb(&b1);
-      (list++)->move = make_promotion(to - DELTA_SW, to, QUEEN);
+        b1 |= dc1;
+        b2 |= dc2;
+      }
     }
 
-    b1 = shift_bb_SE(pawns & Rank2BB) & target;
     while (b1) {
       Square to = pop_lsb(&b1);
-      (list++)->move = make_promotion(to - DELTA_SE, to, QUEEN);
+      (list++)->move = make_move(to - Up, to);
     }
 
-    b1 = shift_bb_S(pawns & Rank2BB) & ~pieces();
-    while (b1) {
-      Square to = pop_lsb(&b1);
-      (list++)->move = make_promotion(to - DELTA_S, to, QUEEN);
+    while (b2) {
+      Square to = pop_lsb(&b2);
+      (list++)->move = make_move(to - Up - Up, to);
     }
   }
 
-  // Regular pawn captures.
-  b1 = shift_bb_SW(pawns & ~Rank2BB) & target;
-  while (b1) {
-    Square to = pop_lsb(&b1);
-    (list++)->move = make_move(to - DELTA_SW, to);
-  }
+  // Promotions and underpromotions
+  if (pawnsOn7 && (!Masked || (target & TRank8BB))) {
+    if (Type == GEN_CAPTURES)
+      emptySquares = ~pieces();
 
-  b1 = shift_bb_SE(pawns & ~Rank2BB) & target;
-  while (b1) {
-    Square to = pop_lsb(&b1);
-    (list++)->move = make_move(to - DELTA_SE, to);
-  }
+    if (Masked)
+      emptySquares &= target;
 
-  // En passant.
-  if (ep_square() != 0) {
-     assert(rank_of(ep_square()) == relative_rank(BLACK, RANK_6));
+    Bitboard b1 = shift_bb(Right, pawnsOn7) & enemies;
+    Bitboard b2 = shift_bb(Left , pawnsOn7) & enemies;
+    Bitboard b3 = shift_bb(Up   , pawnsOn7) & emptySquares;
 
-     b1 = pawns & attacks_from_pawn(ep_square(), WHITE);
+    while (b1)
+      list = make_promotions(list, pop_lsb(&b1), pos->st->ksq, Type, Right);
 
-     assert(b1);
+    while (b2)
+      list = make_promotions(list, pop_lsb(&b2), pos->st->ksq, Type, Left);
 
-     while (b1)
-       (list++)->move = make_enpassant(pop_lsb(&b1), ep_square());
+    while (b3)
+      list = make_promotions(list, pop_lsb(&b3), pos->st->ksq, Type, Up);
   }
 
-  return list;
-}
+  // Standard and en-passant captures
+  if (   Type == GEN_CAPTURES || Type == GEN_EVASIONS
+      || Type == GEN_NON_EVASIONS || Type == GEN_LEGAL) {
+    Bitboard b1 = shift_bb(Right, pawnsNotOn7) & enemies;
+    Bitboard b2 = shift_bb(Left , pawnsNotOn7) & enemies;
 
-INLINE ExtMove *gen_pawn_evasions_white(Pos *pos, ExtMove *list,
-                                               Bitboard target, Square checksq)
-{
-  Bitboard pawns, b1, b2;
-
-  pawns = pieces_cp(WHITE, PAWN);
-
-  // Pawn captures of attacking piece.
-  b1 = attacks_from_pawn(checksq, BLACK) & pawns;
-  while (b1) {
-    Square from = pop_lsb(&b1);
-    if (checksq < SQ_A8)
-      (list++)->move = make_move(from, checksq);
-    else {
-      (list++)->move = make_promotion(from, checksq, QUEEN);
-      (list++)->move = make_promotion(from, checksq, ROOK);
-      (list++)->move = make_promotion(from, checksq, BISHOP);
-      (list++)->move = make_promotion(from, checksq, KNIGHT);
-    }
-  }
-
-  if (ep_square() != 0 && ep_square() == checksq + DELTA_N) {
-    b1 = attacks_from_pawn(ep_square(), BLACK) & pawns;
     while (b1) {
-      Square from = pop_lsb(&b1);
-      (list++)->move = make_enpassant(from, ep_square());
+      Square to = pop_lsb(&b1);
+      (list++)->move = make_move(to - Right, to);
     }
-  }
 
-  // Interposing single and double pushes.
-  target = shift_bb_S(target);
-  b1 = target & pawns;
-  b2 = shift_bb_S(target & ~pieces()) & pawns & Rank2BB;
-  while (b1) {
-    Square from = pop_lsb(&b1);
-    if (from < SQ_A8)
-      (list++)->move = make_move(from, from + DELTA_N);
-    else {
-      (list++)->move = make_promotion(from, from + DELTA_N, QUEEN);
-      (list++)->move = make_promotion(from, from + DELTA_N, ROOK);
-      (list++)->move = make_promotion(from, from + DELTA_N, BISHOP);
-      (list++)->move = make_promotion(from, from + DELTA_N, KNIGHT);
+    while (b2) {
+      Square to = pop_lsb(&b2);
+      (list++)->move = make_move(to - Left, to);
     }
-  }
-  while (b2) {
-    Square from = pop_lsb(&b2);
-    (list++)->move = make_move(from, from + DELTA_NN);
-  }
 
-  return list;
-}
+    if (Type != GEN_LEGAL && ep_square() != 0) {
+      assert(rank_of(ep_square()) == relative_rank(Us, RANK_6));
 
-INLINE ExtMove *gen_pawn_evasions_black(Pos *pos, ExtMove *list,
-                                               Bitboard target, Square checksq)
-{
-  Bitboard pawns, b1, b2;
-
-  pawns = pieces_cp(BLACK, PAWN);
-
-  // Pawn captures of attacking piece.
-  b1 = attacks_from_pawn(checksq, WHITE) & pawns;
-  while (b1) {
-    Square from = pop_lsb(&b1);
-    if (checksq > SQ_H1)
-      (list++)->move = make_move(from, checksq);
-    else {
-      (list++)->move = make_promotion(from, checksq, QUEEN);
-      (list++)->move = make_promotion(from, checksq, ROOK);
-      (list++)->move = make_promotion(from, checksq, BISHOP);
-      (list++)->move = make_promotion(from, checksq, KNIGHT);
-    }
-  }
+      // An en passant capture can be an evasion only if the checking piece
+      // is the double pushed pawn and so is in the target. Otherwise this
+      // is a discovery check and we are forced to do otherwise.
+      if (Type == GEN_EVASIONS && !(target & sq_bb(ep_square() - Up)))
+        return list;
 
-  if (ep_square() != 0 && ep_square() == checksq + DELTA_S) {
-    b1 = attacks_from_pawn(ep_square(), WHITE) & pawns;
-    while (b1) {
-      Square from = pop_lsb(&b1);
-      (list++)->move = make_enpassant(from, ep_square());
-    }
-  }
+      b1 = pawnsNotOn7 & attacks_from_pawn(ep_square(), Them);
+
+      assert(b1);
 
-  // Interposing single and double pushes.
-  target = shift_bb_N(target);
-  b1 = target & pawns;
-  b2 = shift_bb_N(target & ~pieces()) & pawns & Rank7BB;
-  while (b1) {
-    Square from = pop_lsb(&b1);
-    if (from > SQ_H1)
-      (list++)->move = make_move(from, from + DELTA_S);
-    else {
-      (list++)->move = make_promotion(from, from + DELTA_S, QUEEN);
-      (list++)->move = make_promotion(from, from + DELTA_S, ROOK);
-      (list++)->move = make_promotion(from, from + DELTA_S, BISHOP);
-      (list++)->move = make_promotion(from, from + DELTA_S, KNIGHT);
+      while (b1)
+        (list++)->move = make_enpassant(pop_lsb(&b1), ep_square());
     }
   }
-  while (b2) {
-    Square from = pop_lsb(&b2);
-    (list++)->move = make_move(from, from + DELTA_SS);
-  }
 
   return list;
 }
 
-INLINE ExtMove *gen_pawn_checks_white(Pos *pos, ExtMove *list,
-                                             CheckInfo *ci)
-{
-  Bitboard pawns, target, b1, b2;
 
-  pawns = pieces_cp(WHITE, PAWN);
-  target = shift_bb_S(attacks_from_pawn(ci->ksq, BLACK) & ~pieces());
+INLINE ExtMove *generate_moves(Pos *pos, ExtMove *list, int us,
+                               Bitboard target, const int Pt, const int Checks)
+{
+  assert(Pt != KING && Pt != PAWN);
 
-  // Single pawn pushes.
-  b1 = target & pawns;
-  while (b1) {
-    Square to = pop_lsb(&b1);
-    (list++)->move = make_move(to, to + DELTA_N);
-  }
+  Square from;
 
-  // Double pawn pushes.
-  if (target & Rank3BB) {
-    b1 = shift_bb_S(target & ~pieces()) & pawns;
-    while (b1) {
-      Square to = pop_lsb(&b1);
-      (list++)->move = make_move(to, to + DELTA_NN);
-    }
-  }
+  loop_through_pieces(us, Pt, from) {
+    if (Checks) {
+      if (    (Pt == BISHOP || Pt == ROOK || Pt == QUEEN)
+          && !(PseudoAttacks[Pt][from] & target & pos->st->checkSquares[Pt]))
+          continue;
 
-  // Discovered checks.
-  if ((b1 = pawns & ~Rank7BB & ci->dcCandidates)) {
-    b1 = shift_bb_N(b1) & ~pieces();
-    b2 = shift_bb_N(b1 & Rank3BB) & ~pieces();
-    while (b1) {
-      Square to = pop_lsb(&b1);
-      (list++)->move = make_move(to - DELTA_N, to);
-    }
-    while (b2) {
-      Square to = pop_lsb(&b2);
-      (list++)->move = make_move(to - DELTA_NN, to);
+      if (blockers_for_king(pos, us ^ 1) & sq_bb(from))
+        continue;
     }
-  }
 
-  // Knight underpromotions with check.
-  pawns &= Rank7BB;
-  if (pawns & (target = attacks_from_knight(ci->ksq) & Rank8BB)) {
-    b1 = shift_bb_NE(pawns) & pieces_c(BLACK) & target;
-    while (b1) {
-      Square to = pop_lsb(&b1);
-      (list++)->move = make_promotion(to - DELTA_NE, to, KNIGHT);
-    }
+    Bitboard b = attacks_from(Pt, from) & target;
 
-    b1 = shift_bb_NW(pawns) & pieces_c(BLACK) & target;
-    while (b1) {
-      Square to = pop_lsb(&b1);
-      (list++)->move = make_promotion(to - DELTA_NW, to, KNIGHT);
-    }
+    if (Checks)
+      b &= pos->st->checkSquares[Pt];
 
-    b1 = shift_bb_N(pawns) & ~pieces() & target;
-    while (b1) {
-      Square to = pop_lsb(&b1);
-      (list++)->move = make_promotion(to - DELTA_N, to, KNIGHT);
-    }
+    while (b)
+      (list++)->move = make_move(from, pop_lsb(&b));
   }
 
   return list;
 }
 
-INLINE ExtMove *gen_pawn_checks_black(Pos *pos, ExtMove *list,
-                                             CheckInfo *ci)
-{
-  Bitboard pawns, target, b1, b2;
 
-  pawns = pieces_cp(BLACK, PAWN);
-  target = shift_bb_N(attacks_from_pawn(ci->ksq, WHITE) & ~pieces());
-
-  // Single pawn pushes.
-  b1 = target & pawns;
-  while (b1) {
-    Square to = pop_lsb(&b1);
-    (list++)->move = make_move(to, to + DELTA_S);
-  }
+INLINE ExtMove *generate_all(Pos *pos, ExtMove *list, Bitboard target,
+                             const int Us, const int Type)
+{
+  const int Checks = Type == GEN_QUIET_CHECKS;
 
-  // Double pawn pushes.
-  if (target & Rank6BB) {
-    b1 = shift_bb_N(target & ~pieces()) & pawns;
-    while (b1) {
-      Square to = pop_lsb(&b1);
-      (list++)->move = make_move(to, to + DELTA_SS);
-    }
-  }
+  list = generate_pawn_moves(pos, list, pieces_cp(Us, PAWN), target, Us, Type);
+  list = generate_moves(pos, list, Us, target, KNIGHT, Checks);
+  list = generate_moves(pos, list, Us, target, BISHOP, Checks);
+  list = generate_moves(pos, list, Us, target, ROOK, Checks);
+  list = generate_moves(pos, list, Us, target, QUEEN, Checks);
 
-  // Discovered checks.
-  if ((b1 = pawns & ~Rank2BB & ci->dcCandidates)) {
-    b1 = shift_bb_S(b1) & ~pieces();
-    b2 = shift_bb_S(b1 & Rank6BB) & ~pieces();
-    while (b1) {
-      Square to = pop_lsb(&b1);
-      (list++)->move = make_move(to - DELTA_S, to);
-    }
-    while (b2) {
-      Square to = pop_lsb(&b2);
-      (list++)->move = make_move(to - DELTA_SS, to);
-    }
+  if (Type != GEN_QUIET_CHECKS && Type != GEN_EVASIONS) {
+    Square ksq = square_of(Us, KING);
+    Bitboard b = attacks_from_king(ksq) & target;
+    while (b)
+      (list++)->move = make_move(ksq, pop_lsb(&b));
   }
 
-  // Knight underpromotions with check.
-  pawns &= Rank2BB;
-  if (pawns & (target = attacks_from_knight(ci->ksq) & Rank1BB)) {
-    b1 = shift_bb_SW(pawns) & pieces_c(WHITE) & target;
-    while (b1) {
-      Square to = pop_lsb(&b1);
-      (list++)->move = make_promotion(to - DELTA_SW, to, KNIGHT);
-    }
-
-    b1 = shift_bb_SE(pawns) & pieces_c(WHITE) & target;
-    while (b1) {
-      Square to = pop_lsb(&b1);
-      (list++)->move = make_promotion(to - DELTA_SE, to, KNIGHT);
-    }
-
-    b1 = shift_bb_S(pawns) & ~pieces() & target;
-    while (b1) {
-      Square to = pop_lsb(&b1);
-      (list++)->move = make_promotion(to - DELTA_S, to, KNIGHT);
+  if (Type != GEN_CAPTURES && Type != GEN_EVASIONS && can_castle_c(Us)) {
+    if (is_chess960()) {
+      list = generate_castling(pos, list, Us, make_castling_right(Us, KING_SIDE), Checks, 1);
+      list = generate_castling(pos, list, Us, make_castling_right(Us, QUEEN_SIDE), Checks, 1);
+    } else {
+      list = generate_castling(pos, list, Us, make_castling_right(Us, KING_SIDE), Checks, 0);
+      list = generate_castling(pos, list, Us, make_castling_right(Us, QUEEN_SIDE), Checks, 0);
     }
   }
 
   return list;
 }
 
-static ExtMove *gen_piece_moves(Pos *pos, ExtMove *list, Bitboard source,
-                                Bitboard target)
-{
-  Bitboard b1, b2;
-  Square from;
 
-  b1 = pieces_p(KNIGHT) & source;
-  while (b1) {
-    from = pop_lsb(&b1);
-    b2 = attacks_from_knight(from) & target;
-    while (b2)
-      (list++)->move = make_move(from, pop_lsb(&b2));
-  }
+// generate_captures() generates all pseudo-legal captures and queen
+// promotions.
+//
+// generate_quiets() generates all pseudo-legal non-captures and
+// underpromotions.
+//
+// generate_non_evasions() generates all pseudo-legal captures and
+// non-captures.
 
-  b1 = pieces_pp(BISHOP, QUEEN) & source;
-  while (b1) {
-    from = pop_lsb(&b1);
-    b2 = attacks_from_bishop(from) & target;
-    while (b2)
-      (list++)->move = make_move(from, pop_lsb(&b2));
-  }
+INLINE ExtMove *generate(Pos *pos, ExtMove *list, const int Type)
+{
+  assert(Type == GEN_CAPTURES || Type == GEN_QUIETS || Type == GEN_NON_EVASIONS);
+  assert(!pos_checkers());
 
-  b1 = pieces_pp(ROOK, QUEEN) & source;
-  while (b1) {
-    from = pop_lsb(&b1);
-    b2 = attacks_from_rook(from) & target;
-    while (b2)
-      (list++)->move = make_move(from, pop_lsb(&b2));
-  }
+  int us = pos_stm();
 
-  b1 = pieces_p(KING) & source;
-  if (b1) {
-    from = lsb(pieces_p(KING) & source);
-    b2 = attacks_from_king(from) & target;
-    while (b2)
-      (list++)->move = make_move(from, pop_lsb(&b2));
-  }
+  Bitboard target =  Type == GEN_CAPTURES     ?  pieces_c(us ^ 1)
+                   : Type == GEN_QUIETS       ? ~pieces()
+                   : Type == GEN_NON_EVASIONS ? ~pieces_c(us) : 0;
 
-  return list;
+  return us == WHITE ? generate_all(pos, list, target, WHITE, Type)
+                     : generate_all(pos, list, target, BLACK, Type);
 }
 
-
-// generate_quiets() generates all pseudo-legal captures and queen
-// promotions. Returns a pointer to the end of the move list.
+// "template" instantiations
 
 ExtMove *generate_captures(Pos *pos, ExtMove *list)
 {
-  assert(!pos_checkers());
-
-  if (pos_stm() == WHITE)
-    list = gen_pawn_captures_white(pos, list);
-  else
-    list = gen_pawn_captures_black(pos, list);
-
-  return gen_piece_moves(pos, list, pieces_c(pos_stm()), pieces_c(pos_stm() ^ 1));
+  return generate(pos, list, GEN_CAPTURES);
 }
 
-// generate_quiets() generates all pseudo-legal non-captures and
-// underpromotions.
-
 ExtMove *generate_quiets(Pos *pos, ExtMove *list)
 {
-  assert(!pos_checkers());
-
-  if (pos_stm() == WHITE) {
-    list = gen_pawn_pushes_white(pos, list);
-    list = gen_castling_white(pos, list);
-  } else {
-    list = gen_pawn_pushes_black(pos, list);
-    list = gen_castling_black(pos, list);
-  }
-
-  return gen_piece_moves(pos, list, pieces_c(pos_stm()), ~pieces());
+  return generate(pos, list, GEN_QUIETS);
 }
 
-// generate_non_evasions() generates all pseudo-legal captures and
-// non-captures.
-
 ExtMove *generate_non_evasions(Pos *pos, ExtMove *list)
 {
-  assert(!pos_checkers());
-
-  if (pos_stm() == WHITE) {
-    list = gen_pawn_captures_white(pos, list);
-    list = gen_pawn_pushes_white(pos, list);
-    list = gen_castling_white(pos, list);
-  } else {
-    list = gen_pawn_captures_black(pos, list);
-    list = gen_pawn_pushes_black(pos, list);
-    list = gen_castling_black(pos, list);
-  }
-
-  return gen_piece_moves(pos, list, pieces_c(pos_stm()), ~pieces_c(pos_stm()));
+  return generate(pos, list, GEN_NON_EVASIONS);
 }
 
+
 // generate_quiet_checks() generates all pseudo-legal non-captures and
 // knight underpromotions that give check.
-
-ExtMove *generate_quiet_checks(Pos *pos, ExtMove* list)
+ExtMove *generate_quiet_checks(Pos *pos, ExtMove *list)
 {
   assert(!pos_checkers());
 
-  CheckInfo ci;
-  checkinfo_init(&ci, pos);
-
-  Bitboard dc = ci.dcCandidates;
-  Bitboard not_done = pieces_c(pos_stm()) ^ dc;
+  int us = pos_stm();
+  Bitboard dc = discovered_check_candidates(pos);
 
   while (dc) {
     Square from = pop_lsb(&dc);
     int pt = type_of_p(piece_on(from));
 
     if (pt == PAWN)
-      continue; // Will be generated together with direct pawn checks
+      continue; // Will be generated together with direct checks
 
     Bitboard b = attacks_from(pt, from) & ~pieces();
 
     if (pt == KING)
-      b &= ~PseudoAttacks[QUEEN][ci.ksq];
+      b &= ~PseudoAttacks[QUEEN][pos->st->ksq];
 
     while (b)
       (list++)->move = make_move(from, pop_lsb(&b));
   }
 
-  if (pos_stm() == WHITE)
-    list = gen_pawn_checks_white(pos, list, &ci);
-  else
-    list = gen_pawn_checks_black(pos, list, &ci);
-
-  // Generate castling moves and keep them if they are checks.
-  // If two castling moves were generated, at most one of them checks.
-  ExtMove *p;
-  if (pos_stm() == WHITE)
-    p = gen_castling_white(pos, list);
-  else
-    p = gen_castling_black(pos, list);
-  if (list < p) {
-    if (gives_check(pos, list->move, &ci))
-      list++;
-    else if (list + 1 < p && gives_check(pos, (list+1)->move, &ci)) {
-      list->move = (list+1)->move;
-      list++;
-    }
-  }
-
-  // Direct quiet checks by knights, bishops, rooks and queens.
-  Bitboard b1, b2, target;
-  if ((b1 = pieces_p(KNIGHT) & not_done)) {
-    target = attacks_from_knight(ci.ksq) & ~pieces();
-    while (b1) {
-      Square from = pop_lsb(&b1);
-      b2 = attacks_from_knight(from) & target;
-      while (b2)
-        (list++)->move = make_move(from, pop_lsb(&b2));
-    }
-  }
-  if ((b1 = pieces_pp(BISHOP, QUEEN) & not_done)) {
-    target = attacks_from_bishop(ci.ksq) & ~pieces();
-    while (b1) {
-      Square from = pop_lsb(&b1);
-      b2 = attacks_from_bishop(from) & target;
-      while (b2)
-        (list++)->move = make_move(from, pop_lsb(&b2));
-    }
-  }
-  if ((b1 = pieces_pp(ROOK, QUEEN) & not_done)) {
-    target = attacks_from_rook(ci.ksq) & ~pieces();
-    while (b1) {
-      Square from = pop_lsb(&b1);
-      b2 = attacks_from_rook(from) & target;
-      while (b2)
-        (list++)->move = make_move(from, pop_lsb(&b2));
-    }
-  }
-
-  return list;
+  return us == WHITE
+        ? generate_all(pos, list, ~pieces(), WHITE, GEN_QUIET_CHECKS)
+        : generate_all(pos, list, ~pieces(), BLACK, GEN_QUIET_CHECKS);
 }
 
-// generate_evasions() generates all pseudo-legal check evasions.
 
+// generate_evasions() generates all pseudo-legal check evasions when the
+// side to move is in check.
 ExtMove *generate_evasions(Pos *pos, ExtMove *list)
 {
   assert(pos_checkers());
 
-  Square ksq = square_of(pos_stm(), KING);
+  int us = pos_stm();
+  Square ksq = square_of(us, KING);
   Bitboard sliderAttacks = 0;
   Bitboard sliders = pos_checkers() & ~pieces_pp(KNIGHT, PAWN);
 
   // Find all the squares attacked by slider checkers. We will remove them
-  // from the king evasions in order to skip known illegal moves.
+  // from the king evasions in order to skip known illegal moves, which
+  // avoids any useless legality checks later on.
   while (sliders) {
     Square checksq = pop_lsb(&sliders);
-    sliderAttacks |= LineBB[checksq][ksq] ^ sq_bb(checksq);
+    sliderAttacks |= LineBB[ksq][checksq] ^ sq_bb(checksq);
   }
 
-  // Generate evasions for king, capture and non-capture moves.
-  Bitboard b = attacks_from_king(ksq) & ~pieces_c(pos_stm()) & ~sliderAttacks;
+  // Generate evasions for king, capture and non capture moves
+  Bitboard b = attacks_from_king(ksq) & ~pieces_c(us) & ~sliderAttacks;
   while (b)
-    (list++)->move = make_move(ksq, pop_lsb(&b));
+      (list++)->move = make_move(ksq, pop_lsb(&b));
 
   if (more_than_one(pos_checkers()))
-    return list; // Double check; only a king move can save the day.
+      return list; // Double check, only a king move can save the day
 
-  // Generate blocking evasions or captures of the checking piece.
+  // Generate blocking evasions or captures of the checking piece
   Square checksq = lsb(pos_checkers());
-  Bitboard target = between_bb(checksq, ksq);
+  Bitboard target = between_bb(ksq, checksq) | sq_bb(checksq);
 
-  if (pos_stm() == WHITE)
-    list = gen_pawn_evasions_white(pos, list, target, checksq);
-  else
-    list = gen_pawn_evasions_black(pos, list, target, checksq);
-
-  return gen_piece_moves(pos, list, pieces_c(pos_stm()) & ~pieces_p(KING),
-                         target | sq_bb(checksq));
+  return us == WHITE ? generate_all(pos, list, target, WHITE, GEN_EVASIONS)
+                     : generate_all(pos, list, target, BLACK, GEN_EVASIONS);
 }
 
 
-// generate_legal() generates all legal moves.
+// generate_legal_all() generates the legal moves for side Us without
+// testing each move afterwards. The squares a non-king move may go to are
+// limited by a check mask (the checker and the squares between it and
+// our king, or all squares when not in check) and, for pinned pieces, by
+// the line through the king and the pinned piece. In check, pinned pieces
+// cannot move at all. King moves are tested with the king taken off the
+// board, so that moving along the line of a checking slider is rejected.
 
-ExtMove *generate_legal(Pos *pos, ExtMove *list)
+INLINE ExtMove *generate_legal_all(Pos *pos, ExtMove *list, const int Us)
 {
-  Bitboard pinned = pinned_pieces(pos, pos_stm());
-  Square ksq = square_of(pos_stm(), KING);
-  ExtMove* cur = list;
-
-  list = pos_checkers() ? generate_evasions(pos, list)
-                        : generate_non_evasions(pos, list);
-  while (cur != list)
-    if (   (pinned || from_sq(cur->move) == ksq
-                               || type_of_m(cur->move) == ENPASSANT)
-        && !is_legal(pos, cur->move, pinned))
-      cur->move = (--list)->move;
-    else
-      cur++;
+  const int Them = (Us == WHITE ? BLACK : WHITE);
+
+  Square ksq = square_of(Us, KING);
+  Bitboard pinned = pinned_pieces(pos, Us);
+  Bitboard occupied = pieces() ^ sq_bb(ksq);
+  Bitboard b, checkMask;
+
+  b = attacks_from_king(ksq) & ~pieces_c(Us);
+  while (b) {
+    Square to = pop_lsb(&b);
+    if (!(attackers_to_occ(to, occupied) & pieces_c(Them)))
+      (list++)->move = make_move(ksq, to);
+  }
+
+  if (pos_checkers()) {
+    if (more_than_one(pos_checkers()))
+      return list; // Double check, only a king move can save the day
+
+    Square checksq = lsb(pos_checkers());
+    checkMask = between_bb(ksq, checksq) | sq_bb(checksq);
+  } else
+    checkMask = ~pieces_c(Us);
+
+  // Pieces that are free to move
+  Bitboard pawns = pieces_cp(Us, PAWN) & ~pinned;
+  list = generate_pawn_moves(pos, list, pawns, checkMask, Us, GEN_LEGAL);
+
+  b = pieces_cp(Us, KNIGHT) & ~pinned;
+  while (b) {
+    Square from = pop_lsb(&b);
+    Bitboard att = attacks_from_knight(from) & checkMask;
+    while (att)
+      (list++)->move = make_move(from, pop_lsb(&att));
+  }
+
+  b = pieces_cpp(Us, BISHOP, QUEEN) & ~pinned;
+  while (b) {
+    Square from = pop_lsb(&b);
+    Bitboard att = attacks_from_bishop(from) & checkMask;
+    while (att)
+      (list++)->move = make_move(from, pop_lsb(&att));
+  }
+
+  b = pieces_cpp(Us, ROOK, QUEEN) & ~pinned;
+  while (b) {
+    Square from = pop_lsb(&b);
+    Bitboard att = attacks_from_rook(from) & checkMask;
+    while (att)
+      (list++)->move = make_move(from, pop_lsb(&att));
+  }
+
+  // Pinned pieces may only move along the pin ray. Knights never can.
+  if (!pos_checkers()) {
+    b = pinned & ~pieces_p(KNIGHT);
+    while (b) {
+      Square from = pop_lsb(&b);
+      Bitboard ray = LineBB[ksq][from] & checkMask;
+      if (pieces_p(PAWN) & sq_bb(from))
+        list = generate_pawn_moves(pos, list, sq_bb(from), ray, Us, GEN_LEGAL);
+      else {
+        Bitboard att = attacks_from(type_of_p(piece_on(from)), from) & ray;
+        while (att)
+          (list++)->move = make_move(from, pop_lsb(&att));
+      }
+    }
+
+    if (can_castle_c(Us)) {
+      if (is_chess960()) {
+        list = generate_castling(pos, list, Us, make_castling_right(Us, KING_SIDE), 0, 1);
+        list = generate_castling(pos, list, Us, make_castling_right(Us, QUEEN_SIDE), 0, 1);
+      } else {
+        list = generate_castling(pos, list, Us, make_castling_right(Us, KING_SIDE), 0, 0);
+        list = generate_castling(pos, list, Us, make_castling_right(Us, QUEEN_SIDE), 0, 0);
+      }
+    }
+  }
+
+  // En passant captures can expose the king along the rank of the two
+  // pawns, so they are rare enough to be tested with is_legal(). In check
+  // they must capture the checker or block a slider check.
+  if (ep_square() != 0) {
+    const int Up = (Us == WHITE ? DELTA_N : DELTA_S);
+    Square to = ep_square();
+
+    if (checkMask & (sq_bb(to) | sq_bb(to - Up))) {
+      b = pieces_cp(Us, PAWN) & attacks_from_pawn(to, Them);
+      while (b) {
+        Move m = make_enpassant(pop_lsb(&b), to);
+        if (is_legal(pos, m))
+          (list++)->move = m;
+      }
+    }
+  }
 
   return list;
 }
-#endif
 
+
+// generate_legal() generates all the legal moves in the given position.
+
+ExtMove *generate_legal(Pos *pos, ExtMove *list)
+{
+  return pos_stm() == WHITE ? generate_legal_all(pos, list, WHITE)
+                            : generate_legal_all(pos, list, BLACK);
+}
@@ -19,6 +19,9 @@
 */
 
 #include <assert.h>
+#ifdef USE_AVX2
+#include <immintrin.h>
+#endif
 
 #include "movepick.h"
 #include "thread.h"
@@ -76,6 +79,26 @@ static Move pick_best(ExtMove *begin, ExtMove *end)
 {
   ExtMove *p, *q, tmp;
 
+#ifdef USE_AVX2
+  // With AVX2 we first find the highest value four moves at a time. An
+  // ExtMove is 8 bytes, so a 256-bit load holds the moves in the even and
+  // the values in the odd 32-bit lanes. Then we look for the first move
+  // with that value, which is the move the scalar loop would pick.
+  if (end - begin >= 8) {
+    const __m256i none = _mm256_set1_epi32(INT32_MIN);
+    __m256i vmax = none;
+    for (q = begin; q + 4 <= end; q += 4)
+      vmax = _mm256_max_epi32(vmax, _mm256_blend_epi32(none,
+                                _mm256_loadu_si256((__m256i *)q), 0xAA));
+    __m128i m = _mm_max_epi32(_mm256_castsi256_si128(vmax),
+                              _mm256_extracti128_si256(vmax, 1));
+    m = _mm_max_epi32(m, _mm_shuffle_epi32(m, _MM_SHUFFLE(1, 0, 3, 2)));
+    Value best = _mm_extract_epi32(m, 1);
+    for (; q < end; q++)
+      best = max(best, q->value);
+    for (p = begin; p->value != best; p++) {}
+  } else
+#endif
   for (p = begin, q = begin + 1; q < end; q++)
     if (q->value > p->value)
       p = q;
@@ -163,7 +186,33 @@ static void score_captures(Pos *pos)
   // Winning and equal captures in the main search are ordered by MVV,
   // preferring captures near our home rank.
 
-  for (ExtMove *m = st->cur; m < st->endMoves; m++)
+  ExtMove *m = st->cur;
+
+#ifdef USE_AVX2
+  // Score four moves at a time. The gathers only look at the even 32-bit
+  // lanes, which hold the moves, and the scores are blended into the odd
+  // lanes, which hold the values. Reading 4 bytes from pos->board[63]
+  // stays within the Pos struct.
+  const __m256i moves = _mm256_set1_epi64x(0xffffffff);
+  const __m256i flip = _mm256_set1_epi32(pos_stm() == WHITE ? 0 : 7);
+  const __m256i zero = _mm256_setzero_si256();
+
+  for (; m + 4 <= st->endMoves; m += 4) {
+    __m256i v = _mm256_loadu_si256((__m256i *)m);
+    __m256i to = _mm256_and_si256(v, _mm256_set1_epi32(0x3f));
+    __m256i pc = _mm256_mask_i32gather_epi32(zero, (const int *)pos->board,
+                                             to, moves, 1);
+    pc = _mm256_and_si256(pc, _mm256_set1_epi32(0xff));
+    __m256i val = _mm256_mask_i32gather_epi32(zero, PieceValue[MG], pc,
+                                              moves, 4);
+    __m256i r = _mm256_xor_si256(_mm256_srli_epi32(to, 3), flip);
+    val = _mm256_sub_epi32(val, _mm256_mullo_epi32(r, _mm256_set1_epi32(200)));
+    v = _mm256_blend_epi32(v, _mm256_slli_epi64(val, 32), 0xAA);
+    _mm256_storeu_si256((__m256i *)m, v);
+  }
+#endif
+
+  for (; m < st->endMoves; m++)
     m->value =  PieceValue[MG][piece_on(to_sq(m->move))]
               - (Value)(200 * relative_rank_s(pos_stm(), to_sq(m->move)));
 }
@@ -179,8 +228,46 @@ static void score_quiets(Pos *pos)
   CounterMoveStats *f2 = (st-4)->counterMoves;
 //if(!cm || !fm || !f2)printf("st->ply = %d (%d,%d,%d)\n", st->ply, !!cm, !!fm, !!f2);
   int c = pos_stm();
+  ExtMove *m = st->cur;
+
+#ifdef USE_AVX2
+  // Same lane layout as in score_captures(). Missing counter move tables
+  // are replaced by masking out their gathers.
+  const __m256i moves = _mm256_set1_epi64x(0xffffffff);
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i cmMask = cm ? moves : zero;
+  const __m256i fmMask = fm ? moves : zero;
+  const __m256i f2Mask = f2 ? moves : zero;
+  const int *cmBase = cm ? &(*cm)[0][0] : NULL;
+  const int *fmBase = fm ? &(*fm)[0][0] : NULL;
+  const int *f2Base = f2 ? &(*f2)[0][0] : NULL;
+
+  for (; m + 4 <= st->endMoves; m += 4) {
+    __m256i v = _mm256_loadu_si256((__m256i *)m);
+    __m256i to = _mm256_and_si256(v, _mm256_set1_epi32(0x3f));
+    __m256i from = _mm256_and_si256(_mm256_srli_epi32(v, 6),
+                                    _mm256_set1_epi32(0x3f));
+    __m256i pc = _mm256_mask_i32gather_epi32(zero, (const int *)pos->board,
+                                             from, moves, 1);
+    pc = _mm256_and_si256(pc, _mm256_set1_epi32(0xff));
+    __m256i idx = _mm256_or_si256(_mm256_slli_epi32(pc, 6), to);
+    __m256i val = _mm256_mask_i32gather_epi32(zero, &(*history)[0][0], idx,
+                                              moves, 4);
+    val = _mm256_add_epi32(val,
+            _mm256_mask_i32gather_epi32(zero, cmBase, idx, cmMask, 4));
+    val = _mm256_add_epi32(val,
+            _mm256_mask_i32gather_epi32(zero, fmBase, idx, fmMask, 4));
+    val = _mm256_add_epi32(val,
+            _mm256_mask_i32gather_epi32(zero, f2Base, idx, f2Mask, 4));
+    val = _mm256_add_epi32(val,
+            _mm256_mask_i32gather_epi32(zero, (*fromTo)[c],
+                    _mm256_and_si256(v, _mm256_set1_epi32(4095)), moves, 4));
+    v = _mm256_blend_epi32(v, _mm256_slli_epi64(val, 32), 0xAA);
+    _mm256_storeu_si256((__m256i *)m, v);
+  }
+#endif
 
-  for (ExtMove *m = st->cur; m < st->endMoves; m++)
+  for (; m < st->endMoves; m++)
     m->value =   (*history)[moved_piece(m->move)][to_sq(m->move)]
               + (cm ? (*cm)[moved_piece(m->move)][to_sq(m->move)] : 0)
               + (fm ? (*fm)[moved_piece(m->move)][to_sq(m->move)] : 0)
@@ -94,6 +94,18 @@ INLINE Value ft_get(FromToStats ft, int c, Move m)
 #define ST_PROBCUT_GEN             20
 #define ST_PROBCUT_2               21
 
+#ifdef ORDER_STATS
+// order_stage() returns the OS_* stage that produced the move last
+// returned by next_move() in the main search. The stage has already been
+// advanced past the one that returned the move.
+
+INLINE int order_stage(Stack *st)
+{
+  return  st->stage <= ST_BAD_CAPTURES ? st->stage - ST_CAPTURES_GEN
+        : st->stage == ST_ALL_EVASIONS ? OS_TT_MOVE : OS_EVASIONS;
+}
+#endif
+
 void mp_init(Pos *pos, Move ttm, Depth depth);
 void mp_init_q(Pos *pos, Move ttm, Depth depth, Square s);
 void mp_init_pc(Pos *pos, Move ttm, Value threshold);
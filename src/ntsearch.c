@@ -311,6 +311,10 @@ moves_loop: // When in check search starts from here.
                          && (tte_bound(tte) & BOUND_LOWER)
                          &&  tte_depth(tte) >= depth - 3 * ONE_PLY;
 
+#ifdef ORDER_STATS
+  int stageCount[OS_NB] = { 0 };
+#endif
+
   // Step 11. Loop through moves
   // Loop through all pseudo-legal moves until no moves remain or a beta cutoff occurs
   while ((move = next_move(pos))) {
@@ -446,6 +450,11 @@ moves_loop: // When in check search starts from here.
     ss->currentMove = move;
     ss->counterMoves = &(*pos->counterMoveHistory)[moved_piece][to_sq(move)];
 
+#ifdef ORDER_STATS
+    stageCount[order_stage(ss)]++;
+    pos->orderStats.searched[order_stage(ss)]++;
+#endif
+
     // Step 14. Make the move
     do_move(pos, move, givesCheck);
 
@@ -573,6 +582,13 @@ moves_loop: // When in check search starts from here.
           alpha = value;
         else {
           assert(value >= beta); // Fail high
+#ifdef ORDER_STATS
+          OrderStats *os = &pos->orderStats;
+          os->cutoffs[order_stage(ss)]++;
+          os->moveNumber[order_stage(ss)] += moveCount;
+          os->stageNumber[order_stage(ss)] += stageCount[order_stage(ss)];
+          os->firstMove += moveCount == 1;
+#endif
           break;
         }
       }
@@ -594,6 +610,15 @@ moves_loop: // When in check search starts from here.
   // All legal moves have been searched and if there are no legal moves,
   // it must be a mate or a stalemate. If we are in a singular extension
   // search then return a fail low score.
+#ifdef ORDER_STATS
+  if (moveCount && !load_rlx(Signals.stop)) {
+    if (bestValue >= beta)
+      pos->orderStats.cutNodes++;
+    else
+      pos->orderStats.allNodes++;
+  }
+#endif
+
   if (!moveCount)
     bestValue = excludedMove ? alpha
                :     inCheck ? mated_in(ss->ply) : DrawValue[pos_stm()];
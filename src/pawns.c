@@ -82,6 +82,12 @@ static const Value StormDanger[][4][8] = {
 // in front of the king and no enemy pawn on the horizon.
 static const Value MaxSafetyBonus = V(258);
 
+// KingShelter[blockedByKing][distance from edge][our rank][their rank]
+// combines ShelterWeakness and StormDanger into a single penalty per file,
+// indexed by the relative ranks of our backmost and their frontmost pawn
+// on that file (RANK_1 if there is none). It is filled in by pawn_init().
+static Value KingShelter[2][4][8][8];
+
 #undef S
 #undef V
 
@@ -185,6 +191,19 @@ void pawn_init(void)
           v += (apex ? v / 2 : 0);
           Connected[opposed][phalanx][apex][r] = make_score(v, v * 5 / 8);
       }
+
+  enum { NoFriendlyPawn, Unblocked, BlockedByPawn, BlockedByKing };
+
+  for (int byKing = 0; byKing < 2; byKing++)
+    for (int d = 0; d < 4; d++)
+      for (int rkUs = RANK_1; rkUs <= RANK_8; rkUs++)
+        for (int rkThem = RANK_1; rkThem <= RANK_8; rkThem++)
+          KingShelter[byKing][d][rkUs][rkThem] =
+                ShelterWeakness[d][rkUs]
+              + StormDanger[byKing              ? BlockedByKing  :
+                            rkUs == RANK_1      ? NoFriendlyPawn :
+                            rkThem == rkUs + 1  ? BlockedByPawn  : Unblocked]
+                           [d][rkThem];
 }
 
 
@@ -213,14 +232,13 @@ PawnEntry *pawn_probe(Pos *pos)
 INLINE Value shelter_storm(Pos *pos, Square ksq, const int Us)
 {
   const int Them = (Us == WHITE ? BLACK : WHITE);
-  
-  enum { NoFriendlyPawn, Unblocked, BlockedByPawn, BlockedByKing };
 
   Bitboard b = pieces_p(PAWN) & (in_front_bb(Us, rank_of(ksq)) | rank_bb_s(ksq));
   Bitboard ourPawns = b & pieces_c(Us);
   Bitboard theirPawns = b & pieces_c(Them);
   Value safety = MaxSafetyBonus;
   uint32_t center = max(FILE_B, min(FILE_G, file_of(ksq)));
+  uint32_t rkKing = relative_rank_s(Us, ksq);
 
   for (uint32_t f = center - 1; f <= center + 1; f++) {
     b = ourPawns & file_bb(f);
@@ -229,12 +247,8 @@ INLINE Value shelter_storm(Pos *pos, Square ksq, const int Us)
     b  = theirPawns & file_bb(f);
     uint32_t rkThem = b ? relative_rank_s(Us, frontmost_sq(Them, b)) : RANK_1;
 
-    safety -=  ShelterWeakness[min(f, FILE_H - f)][rkUs]
-             + StormDanger
-               [f == file_of(ksq) && rkThem == relative_rank_s(Us, ksq) + 1 ? BlockedByKing  :
-                rkUs   == RANK_1                                            ? NoFriendlyPawn :
-                rkThem == rkUs + 1                                          ? BlockedByPawn  : Unblocked]
-               [min(f, FILE_H - f)][rkThem];
+    int byKing = f == file_of(ksq) && rkThem == rkKing + 1;
+    safety -= KingShelter[byKing][min(f, FILE_H - f)][rkUs][rkThem];
   }
 
   return safety;
@@ -108,6 +108,63 @@ INLINE void set_check_info(Pos *pos)
 }
 
 
+#ifdef ATTACK_MAP
+
+// update_attack_map() recomputes the attacks of the pieces on the changed
+// squares and of the sliders whose rays run into one of them. All other
+// attack sets are unaffected by the move. Since the sliders are found
+// through attackersTo[] before anything is updated, the same call works
+// for undoing the move.
+
+static void update_attack_map(Pos *pos, Bitboard changed)
+{
+  Bitboard affected = changed;
+
+  for (Bitboard b = changed; b; )
+    affected |= pos->attackersTo[pop_lsb(&b)] & (pieces_pp(BISHOP, ROOK) | pieces_p(QUEEN));
+
+  while (affected) {
+    Square s = pop_lsb(&affected);
+    Bitboard old = pos->attacksFrom[s];
+    pos->attacksFrom[s] = piece_on(s) ? attacks_from(piece_on(s), s) : 0;
+    for (Bitboard diff = old ^ pos->attacksFrom[s]; diff; )
+      pos->attackersTo[pop_lsb(&diff)] ^= sq_bb(s);
+  }
+}
+
+// init_attack_map() computes the attack tables from scratch.
+
+static void init_attack_map(Pos *pos)
+{
+  memset(pos->attackersTo, 0, sizeof(pos->attackersTo));
+
+  for (Square s = 0; s < 64; s++) {
+    pos->attacksFrom[s] = piece_on(s) ? attacks_from(piece_on(s), s) : 0;
+    for (Bitboard b = pos->attacksFrom[s]; b; )
+      pos->attackersTo[pop_lsb(&b)] |= sq_bb(s);
+  }
+}
+
+// move_squares() returns the squares whose contents are changed by
+// move m of side 'us'.
+
+INLINE Bitboard move_squares(Move m, int us)
+{
+  Square from = from_sq(m), to = to_sq(m);
+  Bitboard b = sq_bb(from) | sq_bb(to);
+
+  if (type_of_m(m) == CASTLING)
+    b |=  sq_bb(relative_square(us, to > from ? SQ_F1 : SQ_D1))
+        | sq_bb(relative_square(us, to > from ? SQ_G1 : SQ_C1));
+  else if (type_of_m(m) == ENPASSANT)
+    b |= sq_bb(to - pawn_push(us));
+
+  return b;
+}
+
+#endif
+
+
 // print_pos() prints an ASCII representation of the position to stdout.
 
 void print_pos(Pos *pos)
@@ -191,6 +248,7 @@ void pos_set(Pos *pos, char *fen, int isChess960)
 #else
   for (Square s = 0; s < 64; s++)
     CastlingRightsMask[s] = ANY_CASTLING;
+  memset(CastlingPath, 0, sizeof(CastlingPath));
 #endif
 
   // Piece placement
@@ -216,6 +274,10 @@ void pos_set(Pos *pos, char *fen, int isChess960)
     }
   }
 
+#ifdef ATTACK_MAP
+  init_attack_map(pos);
+#endif
+
   // Active color
   token = *fen++;
   pos->sideToMove = token == 'w' ? WHITE : BLACK;
@@ -305,14 +367,13 @@ static void set_castling_right(Pos *pos, int c, Square rfrom)
 #else
   CastlingRightsMask[kfrom] &= ~cr;
   CastlingRightsMask[rfrom] &= ~cr;
-//  CastlingToSquare[rfrom & 0x0f] = kto;
+  // The rook part of the castling move is indexed by the rook square,
+  // which castling moves encode as their destination square.
   int rook = make_piece(c, ROOK);
-  CastlingHash[kto & 0x0f] = zob.psq[rook][rto] ^ zob.psq[rook][rfrom];
-  CastlingPSQ[kto & 0x0f] = psqt.psq[rook][rto] - psqt.psq[rook][rfrom];
-  CastlingBits[kto & 0x0f] = sq_bb(rto) ^ sq_bb(rfrom);
-  // need 2nd set of from/to, maybe... for undo
-  CastlingRookFrom[kto & 0x0f] = rfrom != kto ? rfrom : rto;
-  CastlingRookTo[kto & 0x0f] = rto;
+  CastlingHash[rfrom & 0x0f] = zob.psq[rook][rto] ^ zob.psq[rook][rfrom];
+  CastlingPSQ[rfrom & 0x0f] = psqt.psq[rook][rto] - psqt.psq[rook][rfrom];
+  CastlingBits[rfrom & 0x0f] = sq_bb(rto) ^ sq_bb(rfrom);
+  CastlingRookTo[rfrom & 0x0f] = rto;
   CastlingRookSquare[cr] = rfrom;
 
   for (Square s = min(rfrom, rto); s <= max(rfrom, rto); s++)
@@ -731,12 +792,8 @@ int gives_check_special(Pos *pos, Stack *st, Move m)
   }
   case CASTLING:
   {
-#ifdef PEDANTIC
     // Castling is encoded as 'King captures the rook'
     Square rto = relative_square(pos_stm(), to > from ? SQ_F1 : SQ_D1);
-#else
-    Square rto = CastlingRookTo[to & 0x0f];
-#endif
     return   (PseudoAttacks[ROOK][rto] & sq_bb(st->ksq))
           && (attacks_bb_rook(rto, pieces() ^ sq_bb(from)) & sq_bb(st->ksq));
   }
@@ -754,6 +811,9 @@ void do_move(Pos *pos, Move m, int givesCheck)
   assert(move_is_ok(m));
 
   Stack *st = ++pos->st;
+#ifdef COPY_MAKE
+  memcpy(st->boardCopy, pos, BoardCopySize);
+#endif
   st->previous = st - 1;
   st->pawnKey = (st-1)->pawnKey;
   st->materialKey = (st-1)->materialKey;
@@ -784,10 +844,23 @@ void do_move(Pos *pos, Move m, int givesCheck)
   int prom_piece;
 
   // Move the piece or carry out a promotion.
-  if (type_of_m(m) != PROMOTION) {
-    // In Chess960, the king might seem to capture the friendly rook.
-    if (type_of_m(m) == CASTLING)
-      capt_piece = 0;
+  if (type_of_m(m) == CASTLING) {
+    // Castling is encoded as 'king captures rook'. In Chess960 the king
+    // and rook squares may overlap, so both pieces are lifted first.
+    Square kto = relative_square(us, to > from ? SQ_G1 : SQ_C1);
+    int rook = pos->board[to];
+    capt_piece = 0;
+    pos->byTypeBB[KING] ^= sq_bb(from) ^ sq_bb(kto);
+    pos->byTypeBB[ROOK] ^= CastlingBits[to & 0x0f];
+    pos->byColorBB[us] ^= sq_bb(from) ^ sq_bb(kto) ^ CastlingBits[to & 0x0f];
+    st->psq +=  psqt.psq[piece][kto] - psqt.psq[piece][from]
+              + CastlingPSQ[to & 0x0f];
+    key ^=  zob.psq[piece][from] ^ zob.psq[piece][kto]
+          ^ CastlingHash[to & 0x0f];
+    pos->board[from] = pos->board[to] = 0;
+    pos->board[kto] = piece;
+    pos->board[CastlingRookTo[to & 0x0f]] = rook;
+  } else if (type_of_m(m) != PROMOTION) {
     pos->byTypeBB[type_of_p(piece)] ^= sq_bb(from) ^ sq_bb(to);
     st->psq += psqt.psq[piece][to] - psqt.psq[piece][from];
     key ^= zob.psq[piece][from] ^ zob.psq[piece][to];
@@ -805,9 +878,11 @@ void do_move(Pos *pos, Move m, int givesCheck)
     key ^= zob.psq[piece][from] ^ zob.psq[prom_piece][to];
     st->pawnKey ^= zob.psq[piece][from];
   }
-  pos->byColorBB[us] ^= sq_bb(from) ^ sq_bb(to);
-  pos->board[from] = 0;
-  pos->board[to] = prom_piece;
+  if (type_of_m(m) != CASTLING) {
+    pos->byColorBB[us] ^= sq_bb(from) ^ sq_bb(to);
+    pos->board[from] = 0;
+    pos->board[to] = prom_piece;
+  }
 
   if (capt_piece) {
     st->rule50 = 0;
@@ -836,18 +911,15 @@ void do_move(Pos *pos, Move m, int givesCheck)
           key ^= zob.enpassant[to & 7];
         }
       }
-    } else if (type_of_m(m) == CASTLING) {
-      key ^= CastlingHash[to & 0x0f];
-      pos->byTypeBB[ROOK] ^= CastlingBits[to & 0x0f];
-      pos->byColorBB[us] ^= CastlingBits[to & 0x0f];
-      pos->board[CastlingRookFrom[to & 0x0f]] = 0;
-      pos->board[CastlingRookTo[to & 0x0f]] = ROOK | (to & 0x08);
-      st->psq += CastlingPSQ[to & 0x0f];
     }
   }
   st->key = key;
   pos->byTypeBB[0] = pos->byColorBB[0] | pos->byColorBB[1];
 
+#ifdef ATTACK_MAP
+  update_attack_map(pos, move_squares(m, us));
+#endif
+
   st->checkersBB =  givesCheck
                   ? attackers_to(square_of(us ^ 1, KING)) & pieces_c(us) : 0;
 
@@ -861,6 +933,7 @@ void do_move(Pos *pos, Move m, int givesCheck)
   check_pos(pos);
 }
 
+#ifndef COPY_MAKE
 void undo_move(Pos *pos, Move m)
 {
   int from = from_sq(m);
@@ -870,6 +943,22 @@ void undo_move(Pos *pos, Move m)
   pos->sideToMove ^= 1;
   int us = pos->sideToMove;
  
+  if (type_of_m(m) == CASTLING) {
+    Square kto = relative_square(us, to > from ? SQ_G1 : SQ_C1);
+    pos->byTypeBB[KING] ^= sq_bb(from) ^ sq_bb(kto);
+    pos->byTypeBB[ROOK] ^= CastlingBits[to & 0x0f];
+    pos->byColorBB[us] ^= sq_bb(from) ^ sq_bb(kto) ^ CastlingBits[to & 0x0f];
+    pos->byTypeBB[0] = pos->byColorBB[0] | pos->byColorBB[1];
+    pos->board[kto] = pos->board[CastlingRookTo[to & 0x0f]] = 0;
+    pos->board[from] = make_piece(us, KING);
+    pos->board[to] = make_piece(us, ROOK);
+#ifdef ATTACK_MAP
+    update_attack_map(pos, move_squares(m, us));
+#endif
+    check_pos(pos);
+    return;
+  }
+
   if (type_of_m(m) != PROMOTION) {
     pos->byTypeBB[piece & 7] ^= sq_bb(from) ^ sq_bb(to);
   } else {
@@ -891,16 +980,15 @@ void undo_move(Pos *pos, Move m)
     pos->byTypeBB[capt_piece & 7] ^= sq_bb(to);
     pos->byColorBB[us ^ 1] ^= sq_bb(to);
   }
-  else if (type_of_m(m) == CASTLING) {
-    pos->byTypeBB[ROOK] ^= CastlingBits[to & 0x0f];
-    pos->byColorBB[us] ^= CastlingBits[to & 0x0f];
-    pos->board[CastlingRookTo[to & 0x0f]] = 0;
-    pos->board[CastlingRookFrom[to & 0x0f]] = ROOK | (to & 0x08);
-  }
   pos->byTypeBB[0] = pos->byColorBB[0] | pos->byColorBB[1];
 
+#ifdef ATTACK_MAP
+  update_attack_map(pos, move_squares(m, us));
+#endif
+
   check_pos(pos);
 }
+#endif
 #else
 void do_move(Pos *pos, Move m, int givesCheck)
 {
@@ -916,6 +1004,9 @@ void do_move(Pos *pos, Move m, int givesCheck)
   Stack *st = ++pos->st;
   memcpy(st, st - 1, StateCopySize);
   st->previous = st - 1;
+#ifdef COPY_MAKE
+  memcpy(st->boardCopy, pos, BoardCopySize);
+#endif
 
   // Increment ply counters. In particular, rule50 will be reset to zero
   // later on in case of a capture or a pawn move.
@@ -983,10 +1074,10 @@ void do_move(Pos *pos, Move m, int givesCheck)
     // Update board and piece lists
     remove_piece(pos, them, captured, capsq);
 
-    // Update material hash key and prefetch access to materialTable
+    // Update material hash key and prefetch access to the material entry
     key ^= zob.psq[captured][capsq];
     st->materialKey -= mat_key[captured];
-    prefetch(&pos->materialTable[st->materialKey >> (64 - 13)]);
+    material_prefetch(pos->materialTable, st->materialKey);
 
     // Update incremental scores
     st->psq -= psqt.psq[captured][capsq];
@@ -1037,6 +1128,7 @@ void do_move(Pos *pos, Move m, int givesCheck)
       key ^= zob.psq[piece][to] ^ zob.psq[promotion][to];
       st->pawnKey ^= zob.psq[piece][to];
       st->materialKey += mat_key[promotion] - mat_key[piece];
+      material_prefetch(pos->materialTable, st->materialKey);
 
       // Update incremental score
       st->psq += psqt.psq[promotion][to] - psqt.psq[piece][to];
@@ -1062,6 +1154,10 @@ void do_move(Pos *pos, Move m, int givesCheck)
   // Update the key with the final value
   st->key = key;
 
+#ifdef ATTACK_MAP
+  update_attack_map(pos, move_squares(m, us));
+#endif
+
   // Calculate checkers bitboard (if move gives check)
 #if 1
   st->checkersBB =  givesCheck
@@ -1087,6 +1183,7 @@ void do_move(Pos *pos, Move m, int givesCheck)
 // undo_move() unmakes a move. When it returns, the position should
 // be restored to exactly the same state as before the move was made.
 
+#ifndef COPY_MAKE
 void undo_move(Pos *pos, Move m)
 {
   assert(move_is_ok(m));
@@ -1146,12 +1243,44 @@ void undo_move(Pos *pos, Move m)
     }
   }
 
+#ifdef ATTACK_MAP
+  update_attack_map(pos, move_squares(m, us));
+#endif
+
   // Finally point our state pointer back to the previous state.
   pos->st--;
 
   assert(pos_is_ok(pos, &failed_step));
 }
 #endif
+#endif
+
+#ifdef COPY_MAKE
+// With COPY_MAKE, undo_move() copies back the board representation that
+// do_move() saved in the Stack instead of moving the pieces back.
+
+void undo_move(Pos *pos, Move m)
+{
+  assert(move_is_ok(m));
+
+  memcpy(pos, pos->st->boardCopy, BoardCopySize);
+  pos->sideToMove ^= 1;
+
+#ifdef ATTACK_MAP
+  update_attack_map(pos, move_squares(m, pos_stm()));
+#else
+  (void)m;
+#endif
+
+  pos->st--;
+
+#ifdef PEDANTIC
+  assert(pos_is_ok(pos, &failed_step));
+#else
+  check_pos(pos);
+#endif
+}
+#endif
 
 
 // do_null_move() is used to do a null move.
@@ -1212,6 +1341,57 @@ Key key_after(Pos *pos, Move m)
 }
 
 
+// see_stats_start() and see_stats_add() record the number of calls and
+// the cycles spent in the SEE functions when SEE_STATS is defined.
+
+INLINE uint64_t see_stats_start(void)
+{
+#ifdef SEE_STATS
+  return cpu_cycles();
+#else
+  return 0;
+#endif
+}
+
+INLINE void see_stats_add(Pos *pos, int idx, uint64_t start)
+{
+#ifdef SEE_STATS
+  pos->seeStats.calls[idx]++;
+  pos->seeStats.cycles[idx] += cpu_cycles() - start;
+#else
+  (void)pos, (void)idx, (void)start;
+#endif
+}
+
+
+// see_attackers() returns the attackers to the destination square of m
+// once the moving piece has been removed from 'occ'. With the attack map
+// only the X-ray attacker behind the moving piece has to be looked up.
+// Caching them per node or per target square, without the attack map,
+// measured slower than recomputing them: most squares get only one full
+// SEE, and see_test() usually exits before it needs the attackers.
+
+INLINE Bitboard see_attackers(Pos *pos, Move m, Bitboard occ)
+{
+  Square from = from_sq(m), to = to_sq(m);
+
+#ifdef ATTACK_MAP
+  if (type_of_m(m) != ENPASSANT) {
+    Bitboard attackers = pos->attackersTo[to];
+    if (PseudoAttacks[BISHOP][to] & sq_bb(from))
+      attackers |= attacks_bb_bishop(to, occ) & pieces_pp(BISHOP, QUEEN);
+    else if (PseudoAttacks[ROOK][to] & sq_bb(from))
+      attackers |= attacks_bb_rook(to, occ) & pieces_pp(ROOK, QUEEN);
+    return attackers;
+  }
+#else
+  (void)from;
+#endif
+
+  return attackers_to_occ(to, occ);
+}
+
+
 // see() is a static exchange evaluator: It tries to estimate the
 // material gain or loss resulting from a move.
 
@@ -1228,7 +1408,7 @@ Value see_sign(Pos *pos, Move m)
   return see(pos, m);
 }
 
-Value see(Pos *pos, Move m)
+INLINE Value see_impl(Pos *pos, Move m)
 {
   Square from, to;
   Bitboard occ, attackers, stmAttackers;
@@ -1258,7 +1438,7 @@ Value see(Pos *pos, Move m)
 
   // Find all attackers to the destination square, with the moving piece
   // removed, but possibly an X-ray attacker added behind it.
-  attackers = attackers_to_occ(to, occ) & occ;
+  attackers = see_attackers(pos, m, occ) & occ;
 
   stm ^= 1;
   stmAttackers = attackers & pieces_c(stm);
@@ -1317,8 +1497,15 @@ Value see(Pos *pos, Move m)
   return swapList[0];
 }
 
-// Test whether see(m) >= value.
-int see_test(Pos *pos, Move m, int value)
+Value see(Pos *pos, Move m)
+{
+  uint64_t t = see_stats_start();
+  Value v = see_impl(pos, m);
+  see_stats_add(pos, SEE_PLAIN, t);
+  return v;
+}
+
+INLINE int see_test_impl(Pos *pos, Move m, int value)
 {
   if (type_of_m(m) == CASTLING)
     return 0 >= value;
@@ -1340,7 +1527,7 @@ int see_test(Pos *pos, Move m, int value)
     return 1;
 
   occ ^= sq_bb(from) ^ sq_bb(to);
-  Bitboard attackers = attackers_to_occ(to, occ) & occ;
+  Bitboard attackers = see_attackers(pos, m, occ) & occ;
   int stm = color_of(piece_on(from)) ^ 1;
   int res = 1;
   Bitboard stmAttackers;
@@ -1381,6 +1568,15 @@ int see_test(Pos *pos, Move m, int value)
   return res;
 }
 
+// Test whether see(m) >= value.
+int see_test(Pos *pos, Move m, int value)
+{
+  uint64_t t = see_stats_start();
+  int res = see_test_impl(pos, m, value);
+  see_stats_add(pos, SEE_TEST, t);
+  return res;
+}
+
 #if 0
 int see_test(Pos *pos, Move m, int value)
 {
@@ -1453,6 +1649,14 @@ int pos_is_ok(Pos *pos, int *failedStep)
           || ( ep_square() && relative_rank_s(pos_stm(), ep_square()) != RANK_6))
         return 0;
 
+#ifdef ATTACK_MAP
+    if (step == Default)
+      for (Square s = 0; s < 64; s++)
+        if (   pos->attacksFrom[s] != (piece_on(s) ? attacks_from(piece_on(s), s) : 0)
+            || pos->attackersTo[s] != attackers_to_occ(s, pieces()))
+          return 0;
+#endif
+
 #if 0
     if (step == King)
       if (   std::count(board, board + SQUARE_NB, W_KING) != 1
@@ -44,6 +44,14 @@ extern struct Zob zob;
 void psqt_init(void);
 void zob_init(void);
 
+// With COPY_MAKE, do_move() saves the part of Pos that it changes, from
+// board[] up to and including the piece lists, and undo_move() restores it.
+#ifdef PEDANTIC
+#define BoardCopySize (64 + 9 * sizeof(Bitboard) + 16 + 256 + 64)
+#else
+#define BoardCopySize (64 + 9 * sizeof(Bitboard))
+#endif
+
 // Stack struct stores information needed to restore a Pos struct to
 // its previous state when we retract a move.
 
@@ -104,10 +112,43 @@ struct Stack {
     };
   };
   Square ksq;
+
+#ifdef COPY_MAKE
+  // Board representation before the move that led to this state.
+  Bitboard boardCopy[BoardCopySize / sizeof(Bitboard)];
+#endif
 };
 
 typedef struct Stack Stack;
 
+// Calls to the SEE functions and the cycles spent in them, counted per
+// thread when SEE_STATS is defined.
+
+enum { SEE_PLAIN, SEE_TEST, SEE_NB };
+
+typedef struct {
+  uint64_t calls[SEE_NB];
+  uint64_t cycles[SEE_NB];
+} SeeStats;
+
+// Moves searched and beta cutoffs in the main search, by the move picker
+// stage that returned the move, counted per thread when ORDER_STATS is
+// defined.
+
+enum {
+  OS_TT_MOVE, OS_GOOD_CAPTURES, OS_KILLER_1, OS_KILLER_2, OS_COUNTERMOVE,
+  OS_QUIETS, OS_BAD_CAPTURES, OS_EVASIONS, OS_NB
+};
+
+typedef struct {
+  uint64_t searched[OS_NB];
+  uint64_t cutoffs[OS_NB];
+  uint64_t moveNumber[OS_NB];  // Sum of the move numbers of the cutoffs
+  uint64_t stageNumber[OS_NB]; // Same, counting only moves of the stage
+  uint64_t firstMove;          // Cutoffs by the first move searched
+  uint64_t cutNodes, allNodes; // Nodes with and without a cutoff
+} OrderStats;
+
 #define StateCopySize offsetof(Stack, capturedPiece)
 #define StateSize offsetof(Stack, pv)
 #define SStackBegin(st) (&st.pv)
@@ -131,6 +172,12 @@ struct Pos {
   uint8_t castlingRightsMask[64];
   uint8_t castlingRookSquare[16];
   Bitboard castlingPath[16];
+#endif
+#ifdef ATTACK_MAP
+  // attacksFrom[s] are the squares attacked by the piece on s, and
+  // attackersTo[s] are the squares of the pieces attacking s.
+  Bitboard attacksFrom[64];
+  Bitboard attackersTo[64];
 #endif
   uint8_t sideToMove;
   uint8_t chess960;
@@ -154,8 +201,16 @@ struct Pos {
   MoveStats *counterMoves;
   FromToStats *fromTo;
   PawnEntry *pawnTable;
-  MaterialEntry *materialTable;
+  MaterialHashEntry *materialTable;
   CounterMoveHistoryStats *counterMoveHistory;
+  TBCache *tbCache;
+
+#ifdef SEE_STATS
+  SeeStats seeStats;
+#endif
+#ifdef ORDER_STATS
+  OrderStats orderStats;
+#endif
 
   // Thread-control data.
   atomic_bool resetCalls;
@@ -172,6 +227,16 @@ struct Pos {
 #endif
 };
 
+#ifdef COPY_MAKE
+#ifdef PEDANTIC
+_Static_assert(BoardCopySize == offsetof(Pos, castlingRightsMask),
+               "BoardCopySize does not match struct Pos");
+#else
+_Static_assert(BoardCopySize == offsetof(Pos, byColorBB) + 2 * sizeof(Bitboard),
+               "BoardCopySize does not match struct Pos");
+#endif
+#endif
+
 // FEN string input/output
 void pos_set(Pos *pos, char *fen, int isChess960);
 void pos_fen(Pos *pos, char *fen);
@@ -246,7 +311,11 @@ int pos_is_ok(Pos *pos, int* failedStep);
 
 // Attacks to/from a given square
 #define attackers_to_occ(s,occ) pos_attackers_to_occ(pos,s,occ)
+#ifdef ATTACK_MAP
+#define attackers_to(s) (pos->attackersTo[s])
+#else
 #define attackers_to(s) attackers_to_occ(s,pieces())
+#endif
 #define attacks_from_pawn(s,c) (StepAttacksBB[make_piece(c,PAWN)][s])
 #define attacks_from_knight(s) (StepAttacksBB[KNIGHT][s])
 #define attacks_from_bishop(s) attacks_bb_bishop(s, pieces())
@@ -620,6 +620,26 @@ void thread_search(Pos *pos)
 #undef true
 #undef false
 
+// search_qsearch() returns the quiescence search value of the position
+// from the point of view of the side to move. It is meant to be called on
+// a thread's Pos right after pos_set(), outside of a regular search.
+
+Value search_qsearch(Pos *pos)
+{
+  Move pv[MAX_PLY + 1];
+  Stack *ss = pos->st;
+
+  for (int i = -5; i < 3; i++)
+    memset(SStackBegin(ss[i]), 0, SStackSize);
+  (ss-1)->endMoves = pos->moveList;
+  ss->pv = pv;
+
+  return pos_checkers()
+        ? qsearch_PV_true(pos, ss, -VALUE_INFINITE, VALUE_INFINITE, DEPTH_ZERO)
+        : qsearch_PV_false(pos, ss, -VALUE_INFINITE, VALUE_INFINITE, DEPTH_ZERO);
+}
+
+
 // stable_sort() sorts RootMoves from highest-scoring move to lowest-scoring
 // move while preserving order of equal elements.
 static void stable_sort(RootMove *rm, size_t num)
@@ -765,6 +785,8 @@ static void check_time(void)
   if (tick - lastInfoTime >= 1000) {
     lastInfoTime = tick;
     dbg_print();
+    if (option_value(OPT_SYZ_STATS))
+      TB_print_info();
   }
 
   // An engine may not stop pondering until told so by the GUI
@@ -98,6 +98,7 @@ extern int TB_RootInTB;
 void search_init();
 void search_clear();
 uint64_t perft(Pos *pos, Depth depth);
+Value search_qsearch(Pos *pos);
 
 #endif
 
@@ -8,6 +8,7 @@
 */
 
 #include <stdio.h>
+#include <inttypes.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
@@ -19,9 +20,9 @@
 #endif
 #include "tbcore.h"
 
-#define TBMAX_PIECE 254
-#define TBMAX_PAWN 256
-#define HSHMAX 5
+#define TBMAX_PIECE (TBPIECES < 7 ? 254 : 650)
+#define TBMAX_PAWN (TBPIECES < 7 ? 256 : 861)
+#define HSHMAX (TBPIECES < 7 ? 5 : 8)
 
 #define Swap(a,b) {int tmp=a;a=b;b=tmp;}
 
@@ -48,33 +49,62 @@ static struct TBEntry_pawn TB_pawn[TBMAX_PAWN];
 
 static struct TBHashEntry TB_hash[1 << TBHASHBITS][HSHMAX];
 
-#define DTZ_ENTRIES 64
+// DTZ tables are cached in a hash table of DTZ_size slots indexed by
+// material key, in buckets of DTZ_WAYS slots. Slots are read and replaced
+// with atomic operations, so probes do not take a lock and tables are
+// loaded outside of TB_mutex. A table evicted from its slot may still be
+// in use by another thread, so it is retired and only freed by
+// TB_release_dtz() before the next search starts.
+static struct DTZTableEntry *DTZ_table = NULL;
+static size_t DTZ_size = 0;
+#define DTZ_WAYS ((size_t)4)
+static _Atomic(struct DTZRetired *) DTZ_retired;
 
-static struct DTZTableEntry DTZ_table[DTZ_ENTRIES];
+static struct TBStats TB_stats[TBMAX_PIECE + TBMAX_PAWN];
+static struct TBFile TB_files[TBMAX_PIECE + TBMAX_PAWN];
+
+static const char TBIndexMagic[8] = "CfTBidx1";
+
+// Incremented whenever table data is freed, so that decoded blocks of
+// freed tables are never found in the per-thread block caches.
+static atomic_uint TB_generation;
 
 static void init_indices(void);
 static Key calc_key_from_pcs(int *pcs, int mirror);
 static void free_wdl_entry(struct TBEntry *entry);
 static void free_dtz_entry(struct TBEntry *entry);
+static void dtz_clear(void);
+static int init_table_wdl(struct TBEntry *entry, char *str);
 
-static FD open_tb(const char *str, const char *suffix)
+static FD open_tb_dir(const char *dir, const char *str, const char *suffix)
 {
-  int i;
-  FD fd;
   char file[256];
 
-  for (i = 0; i < num_paths; i++) {
-    strcpy(file, paths[i]);
-    strcat(file, "/");
-    strcat(file, str);
-    strcat(file, suffix);
+  strcpy(file, dir);
+  strcat(file, "/");
+  strcat(file, str);
+  strcat(file, suffix);
 #ifndef _WIN32
-    fd = open(file, O_RDONLY);
+  return open(file, O_RDONLY);
 #else
-    fd = CreateFile(file, GENERIC_READ, FILE_SHARE_READ, NULL,
+  return CreateFile(file, GENERIC_READ, FILE_SHARE_READ, NULL,
                           OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
 #endif
-    if (fd != FD_ERR) return fd;
+}
+
+// open_tb() opens the file in paths[*path], or if *path < 0 in the first
+// of paths holding it, and sets *path to where it was found.
+static FD open_tb(const char *str, const char *suffix, int *path)
+{
+  if (*path >= 0)
+    return open_tb_dir(paths[*path], str, suffix);
+
+  for (int i = 0; i < num_paths; i++) {
+    FD fd = open_tb_dir(paths[i], str, suffix);
+    if (fd != FD_ERR) {
+      *path = i;
+      return fd;
+    }
   }
   return FD_ERR;
 }
@@ -88,15 +118,15 @@ static void close_tb(FD fd)
 #endif
 }
 
-static char *map_file(const char *name, const char *suffix, uint64 *mapping)
+// map_fd() maps the whole of the open file fd and closes it.
+static char *map_fd(FD fd, const char *name, const char *suffix,
+                    uint64 *mapping, uint64 *size)
 {
-  FD fd = open_tb(name, suffix);
-  if (fd == FD_ERR)
-    return NULL;
 #ifndef _WIN32
+  (void)suffix;
   struct stat statbuf;
   fstat(fd, &statbuf);
-  *mapping = statbuf.st_size;
+  *mapping = *size = statbuf.st_size;
   char *data = (char *)mmap(NULL, statbuf.st_size, PROT_READ,
                               MAP_SHARED, fd, 0);
   if (data == (char *)(-1)) {
@@ -106,7 +136,7 @@ static char *map_file(const char *name, const char *suffix, uint64 *mapping)
 #else
   DWORD size_low, size_high;
   size_low = GetFileSize(fd, &size_high);
-//  *size = ((uint64)size_high) << 32 | ((uint64)size_low);
+  *size = ((uint64)size_high) << 32 | ((uint64)size_low);
   HANDLE map = CreateFileMapping(fd, NULL, PAGE_READONLY, size_high, size_low,
                                   NULL);
   if (map == NULL) {
@@ -124,6 +154,15 @@ static char *map_file(const char *name, const char *suffix, uint64 *mapping)
   return data;
 }
 
+static char *map_file(const char *name, const char *suffix, int path,
+                      uint64 *mapping, uint64 *size)
+{
+  FD fd = open_tb(name, suffix, &path);
+  if (fd == FD_ERR)
+    return NULL;
+  return map_fd(fd, name, suffix, mapping, size);
+}
+
 #ifndef _WIN32
 static void unmap_file(char *data, uint64 size)
 {
@@ -139,6 +178,16 @@ static void unmap_file(char *data, uint64 mapping)
 }
 #endif
 
+// tb_checksum() hashes the size and the first 4 KB of a table, which is
+// enough to tell apart different versions of the same table.
+static uint64 tb_checksum(const ubyte *data, uint64 size)
+{
+  uint64 hash = 0xcbf29ce484222325ULL ^ size;
+  for (uint64 i = 0; i < size && i < 4096; i++)
+    hash = (hash ^ data[i]) * 0x100000001b3ULL;
+  return hash;
+}
+
 static void add_to_hash(struct TBEntry *ptr, Key key)
 {
   int i, hshidx;
@@ -151,30 +200,160 @@ static void add_to_hash(struct TBEntry *ptr, Key key)
     fprintf(stderr, "HSHMAX too low!\n");
     exit(1);
   } else {
-    TB_hash[hshidx][i].key = key;
+    // TB_rescan() adds entries while other threads probe, so the key is
+    // published last, with release semantics.
     TB_hash[hshidx][i].ptr = ptr;
+    atomic_store_explicit(&TB_hash[hshidx][i].key, key, memory_order_release);
   }
 }
 
+// restore_hash() makes a table that failed to load available again for
+// another attempt, by restoring the keys that probe_wdl_table() cleared.
+static void restore_hash(struct TBEntry *ptr, Key key)
+{
+  struct TBHashEntry *ptr2 = TB_hash[key >> (64 - TBHASHBITS)];
+  for (int i = 0; i < HSHMAX; i++)
+    if (ptr2[i].ptr == ptr && (ptr2[i].key == key || !ptr2[i].key)) {
+      atomic_store_explicit(&ptr2[i].key, key, memory_order_release);
+      return;
+    }
+}
+
 static char pchr[] = {'K', 'Q', 'R', 'B', 'N', 'P'};
 
-static void init_tb(char *str)
+static int tb_index(struct TBEntry *ptr)
 {
-  FD fd;
-  struct TBEntry *entry;
-  int i, j, pcs[16];
-  Key key, key2;
-  int color;
-  char *s;
+  return ptr->has_pawns
+        ? TBMAX_PIECE + (int)((struct TBEntry_pawn *)ptr - TB_pawn)
+        : (int)((struct TBEntry_piece *)ptr - TB_piece);
+}
 
-  fd = open_tb(str, WDLSUFFIX);
-  if (fd == FD_ERR) return;
-  close_tb(fd);
+// find_entry() returns the registered table with material key key, which
+// may have been disabled in TB_hash after failing to load.
+static struct TBEntry *find_entry(Key key, int has_pawns)
+{
+  if (has_pawns) {
+    for (int i = 0; i < TBnum_pawn; i++)
+      if (TB_pawn[i].key == key)
+        return (struct TBEntry *)&TB_pawn[i];
+  } else {
+    for (int i = 0; i < TBnum_piece; i++)
+      if (TB_piece[i].key == key)
+        return (struct TBEntry *)&TB_piece[i];
+  }
+  return NULL;
+}
 
-  for (i = 0; i < 16; i++)
+static struct TBEntry *wdl_entry(Key key)
+{
+  struct TBHashEntry *ptr2 = TB_hash[key >> (64 - TBHASHBITS)];
+  for (int i = 0; i < HSHMAX; i++)
+    if (atomic_load_explicit(&ptr2[i].key, memory_order_acquire) == key)
+      return ptr2[i].ptr;
+  return NULL;
+}
+
+// Tables selected by TB_warmup() are mapped and read ahead by a single
+// background thread, so that the first probes of the search do not stall
+// on page faults. The thread is stopped and joined before the tables are
+// freed.
+#define WARMUP_MARGIN 2
+
+static struct TBEntry *warm_list[TBMAX_PIECE + TBMAX_PAWN];
+static int warm_num;
+static atomic_int warm_stop;
+static int warm_started = 0;
+#ifndef _WIN32
+static pthread_t warm_thread;
+#else
+static HANDLE warm_thread;
+#endif
+
+static void *warmup_thread(void *arg)
+{
+  (void)arg;
+  TimePoint start = now();
+  uint64_t bytes = 0;
+  int tables = 0;
+
+  for (int i = 0; i < warm_num && !atomic_load(&warm_stop); i++) {
+    struct TBEntry *ptr = warm_list[i];
+    struct TBStats *stats = &TB_stats[tb_index(ptr)];
+    if (!atomic_load_explicit(&ptr->ready, memory_order_acquire)) {
+      LOCK(TB_mutex);
+      if (   !atomic_load_explicit(&ptr->ready, memory_order_relaxed)
+          && init_table_wdl(ptr, stats->name))
+        atomic_store_explicit(&ptr->ready, 1, memory_order_release);
+      UNLOCK(TB_mutex);
+      if (!atomic_load_explicit(&ptr->ready, memory_order_acquire)) {
+        stats->warmed = 1; // Do not retry a missing or corrupted table.
+        continue;
+      }
+    }
+#ifndef _WIN32
+    // Start readahead of the whole file, then touch every page so that
+    // it is resident when the search gets there.
+    madvise(ptr->data, ptr->mapping, MADV_WILLNEED);
+    volatile char sum = 0;
+    uint64 j;
+    for (j = 0; j < ptr->mapping; j += 4096) {
+      if (!(j & 0xfffff) && atomic_load_explicit(&warm_stop, memory_order_relaxed))
+        break;
+      sum += ptr->data[j];
+    }
+    bytes += j < ptr->mapping ? j : ptr->mapping;
+    if (j < ptr->mapping)
+      break;
+#endif
+    stats->warmed = 1;
+    tables++;
+  }
+
+  if (atomic_load(&warm_stop))
+    return NULL;
+
+  IO_LOCK;
+  printf("info string Syzygy warmup: %d tables, %" PRIu64 " MB in %" PRIu64
+         " ms\n", tables, bytes >> 20, (uint64_t)(now() - start));
+  fflush(stdout);
+  IO_UNLOCK;
+
+  return NULL;
+}
+
+static void warmup_wait(void)
+{
+  if (!warm_started)
+    return;
+  atomic_store(&warm_stop, 1);
+#ifndef _WIN32
+  pthread_join(warm_thread, NULL);
+#else
+  WaitForSingleObject(warm_thread, INFINITE);
+  CloseHandle(warm_thread);
+#endif
+  warm_started = 0;
+  atomic_store(&warm_stop, 0);
+}
+
+static void warmup_start(void)
+{
+  warm_started = 1;
+#ifndef _WIN32
+  pthread_create(&warm_thread, NULL, warmup_thread, NULL);
+#else
+  warm_thread = CreateThread(NULL, 0, (LPTHREAD_START_ROUTINE)warmup_thread,
+                             NULL, 0, NULL);
+#endif
+}
+
+static void tb_pcs(const char *str, int *pcs)
+{
+  int color = 0;
+
+  for (int i = 0; i < 16; i++)
     pcs[i] = 0;
-  color = 0;
-  for (s = str; *s; s++)
+  for (const char *s = str; *s; s++)
     switch (*s) {
     case 'P':
       pcs[TB_PAWN | color]++;
@@ -198,11 +377,44 @@ static void init_tb(char *str)
       color = 0x08;
       break;
     }
+}
+
+// add_tb() registers the table str, whose WDL file is in paths[path], and
+// returns its entry, or NULL if it was registered already.
+static struct TBEntry *add_tb(const char *str, int path)
+{
+  struct TBEntry *entry;
+  int i, j, pcs[16];
+  Key key, key2;
+
+  tb_pcs(str, pcs);
   for (i = 0; i < 8; i++)
     if (pcs[i] != pcs[i+8])
       break;
   key = calc_key_from_pcs(pcs, 0);
   key2 = calc_key_from_pcs(pcs, 1);
+
+  // A table found again by TB_rescan() keeps its entry and its mapping.
+  // If it could not be loaded, it is given another chance.
+  entry = find_entry(key, pcs[TB_WPAWN] + pcs[TB_BPAWN] > 0);
+  if (!entry)
+    entry = find_entry(key2, pcs[TB_WPAWN] + pcs[TB_BPAWN] > 0);
+  if (entry) {
+    struct TBStats *stats = &TB_stats[tb_index(entry)];
+    atomic_store_explicit(&stats->dtzMissing, 0, memory_order_relaxed);
+    if (!atomic_load_explicit(&entry->ready, memory_order_acquire)) {
+      LOCK(TB_mutex);
+      restore_hash(entry, key);
+      if (key2 != key) restore_hash(entry, key2);
+      UNLOCK(TB_mutex);
+      stats->warmed = 0;
+      struct TBFile *file = &TB_files[tb_index(entry)];
+      file->path = path;
+      file->size = file->checksum = 0;
+    }
+    return NULL;
+  }
+
   if (pcs[TB_WPAWN] + pcs[TB_BPAWN] == 0) {
     if (TBnum_piece == TBMAX_PIECE) {
       fprintf(stderr, "TBMAX_PIECE limit too low!\n");
@@ -223,6 +435,14 @@ static void init_tb(char *str)
     entry->num += (ubyte)pcs[i];
   entry->symmetric = (key == key2);
   entry->has_pawns = (pcs[TB_WPAWN] + pcs[TB_BPAWN] > 0);
+  struct TBStats *stats = &TB_stats[tb_index(entry)];
+  strcpy(stats->name, str);
+  stats->dtzLoads = stats->dtzEvictions = 0;
+  stats->dtzMissing = 0;
+  stats->warmed = 0;
+  struct TBFile *file = &TB_files[tb_index(entry)];
+  file->path = path;
+  file->size = file->checksum = 0;
   if (entry->num > TB_MaxCardinality)
     TB_MaxCardinality = entry->num;
 
@@ -251,108 +471,56 @@ static void init_tb(char *str)
   }
   add_to_hash(entry, key);
   if (key2 != key) add_to_hash(entry, key2);
+  return entry;
 }
 
-void TB_free(void)
+static void init_tb(const char *str, void *arg)
 {
-  TB_init("");
+  (void)arg;
+  int path = -1;
+  FD fd = open_tb(str, WDLSUFFIX, &path);
+  if (fd == FD_ERR) return;
+  close_tb(fd);
+
+  add_tb(str, path);
 }
 
-void TB_init(char *path)
+// scan_tables() calls found() for the name of each table of up to
+// TBPIECES pieces, such as init_tb() to register those in path_string.
+static void scan_tables(void (*found)(const char *str, void *arg), void *arg)
 {
   char str[16];
   int i, j, k, l;
 
-  if (!initialized) {
-    init_indices();
-    initialized = 1;
-  }
-
-  // if path_string is set, we need to clean up first.
-  if (path_string) {
-    free(path_string);
-    free(paths);
-    struct TBEntry *entry;
-    for (i = 0; i < TBnum_piece; i++) {
-      entry = (struct TBEntry *)&TB_piece[i];
-      free_wdl_entry(entry);
-    }
-    for (i = 0; i < TBnum_pawn; i++) {
-      entry = (struct TBEntry *)&TB_pawn[i];
-      free_wdl_entry(entry);
-    }
-    for (i = 0; i < DTZ_ENTRIES; i++)
-      if (DTZ_table[i].entry)
-        free_dtz_entry(DTZ_table[i].entry);
-    LOCK_DESTROY(TB_mutex);
-    path_string = NULL;
-  }
-
-  // if path is an empty string or equals "<empty>", we are done.
-  const char *p = path;
-  if (strlen(p) == 0 || !strcmp(p, "<empty>")) return;
-
-  path_string = (char *)malloc(strlen(p) + 1);
-  strcpy(path_string, p);
-  num_paths = 0;
-  for (i = 0;; i++) {
-    if (path_string[i] != SEP_CHAR)
-      num_paths++;
-    while (path_string[i] && path_string[i] != SEP_CHAR)
-      i++;
-    if (!path_string[i]) break;
-    path_string[i] = 0;
-  }
-  paths = (char **)malloc(num_paths * sizeof(char *));
-  for (i = j = 0; i < num_paths; i++) {
-    while (!path_string[j]) j++;
-    paths[i] = &path_string[j];
-    while (path_string[j]) j++;
-  }
-
-  LOCK_INIT(TB_mutex);
-
-  TBnum_piece = TBnum_pawn = 0;
-  TB_MaxCardinality = 0;
-
-  for (i = 0; i < (1 << TBHASHBITS); i++)
-    for (j = 0; j < HSHMAX; j++) {
-      TB_hash[i][j].key = 0ULL;
-      TB_hash[i][j].ptr = NULL;
-    }
-
-  for (i = 0; i < DTZ_ENTRIES; i++)
-    DTZ_table[i].entry = NULL;
-
   for (i = 1; i < 6; i++) {
     sprintf(str, "K%cvK", pchr[i]);
-    init_tb(str);
+    found(str, arg);
   }
 
   for (i = 1; i < 6; i++)
     for (j = i; j < 6; j++) {
       sprintf(str, "K%cvK%c", pchr[i], pchr[j]);
-      init_tb(str);
+      found(str, arg);
     }
 
   for (i = 1; i < 6; i++)
     for (j = i; j < 6; j++) {
       sprintf(str, "K%c%cvK", pchr[i], pchr[j]);
-      init_tb(str);
+      found(str, arg);
     }
 
   for (i = 1; i < 6; i++)
     for (j = i; j < 6; j++)
       for (k = 1; k < 6; k++) {
         sprintf(str, "K%c%cvK%c", pchr[i], pchr[j], pchr[k]);
-        init_tb(str);
+        found(str, arg);
       }
 
   for (i = 1; i < 6; i++)
     for (j = i; j < 6; j++)
       for (k = j; k < 6; k++) {
         sprintf(str, "K%c%c%cvK", pchr[i], pchr[j], pchr[k]);
-        init_tb(str);
+        found(str, arg);
       }
 
   for (i = 1; i < 6; i++)
@@ -360,7 +528,7 @@ void TB_init(char *path)
       for (k = i; k < 6; k++)
         for (l = (i == k) ? j : k; l < 6; l++) {
           sprintf(str, "K%c%cvK%c%c", pchr[i], pchr[j], pchr[k], pchr[l]);
-          init_tb(str);
+          found(str, arg);
         }
 
   for (i = 1; i < 6; i++)
@@ -368,7 +536,7 @@ void TB_init(char *path)
       for (k = j; k < 6; k++)
         for (l = 1; l < 6; l++) {
           sprintf(str, "K%c%c%cvK%c", pchr[i], pchr[j], pchr[k], pchr[l]);
-          init_tb(str);
+          found(str, arg);
         }
 
   for (i = 1; i < 6; i++)
@@ -376,13 +544,284 @@ void TB_init(char *path)
       for (k = j; k < 6; k++)
         for (l = k; l < 6; l++) {
           sprintf(str, "K%c%c%c%cvK", pchr[i], pchr[j], pchr[k], pchr[l]);
-          init_tb(str);
+          found(str, arg);
         }
 
+#if TBPIECES >= 7
+  int m;
+
+  for (i = 1; i < 6; i++)
+    for (j = i; j < 6; j++)
+      for (k = j; k < 6; k++)
+        for (l = k; l < 6; l++)
+          for (m = l; m < 6; m++) {
+            sprintf(str, "K%c%c%c%c%cvK", pchr[i], pchr[j], pchr[k], pchr[l], pchr[m]);
+            found(str, arg);
+          }
+
+  for (i = 1; i < 6; i++)
+    for (j = i; j < 6; j++)
+      for (k = j; k < 6; k++)
+        for (l = k; l < 6; l++)
+          for (m = 1; m < 6; m++) {
+            sprintf(str, "K%c%c%c%cvK%c", pchr[i], pchr[j], pchr[k], pchr[l], pchr[m]);
+            found(str, arg);
+          }
+
+  for (i = 1; i < 6; i++)
+    for (j = i; j < 6; j++)
+      for (k = j; k < 6; k++)
+        for (l = 1; l < 6; l++)
+          for (m = l; m < 6; m++) {
+            sprintf(str, "K%c%c%cvK%c%c", pchr[i], pchr[j], pchr[k], pchr[l], pchr[m]);
+            found(str, arg);
+          }
+#endif
+}
+
+void TB_free(void)
+{
+  TB_init("");
+  free(DTZ_table);
+  DTZ_table = NULL;
+  DTZ_size = 0;
+}
+
+// load_index() registers the tables listed in the index file in the first
+// of paths, if the index was made for the SyzygyPath path. The file is read
+// at once, so that startup need not look for thousands of files.
+static int load_index(const char *path)
+{
+  char file[256];
+  snprintf(file, sizeof(file), "%s/" TBINDEX_FILE, paths[0]);
+  FILE *f = fopen(file, "rb");
+  if (!f)
+    return 0;
+
+  fseek(f, 0, SEEK_END);
+  long size = ftell(f);
+  rewind(f);
+  char *buf = malloc(size > 0 ? size : 1);
+  int ok =   size >= (long)sizeof(struct TBIndexHeader)
+          && fread(buf, 1, size, f) == (size_t)size;
+  fclose(f);
+
+  struct TBIndexHeader *hdr = (struct TBIndexHeader *)buf;
+  struct TBIndexEntry *ent = NULL;
+  if (ok) {
+    size_t offset = sizeof(struct TBIndexHeader) + ((hdr->pathLen + 8) & ~7);
+    ent = (struct TBIndexEntry *)(buf + offset);
+    ok =   !memcmp(hdr->magic, TBIndexMagic, sizeof(TBIndexMagic))
+        && offset + (size_t)hdr->num * sizeof(struct TBIndexEntry) == (size_t)size
+        && hdr->pathLen == strlen(path)
+        && !memcmp(buf + sizeof(struct TBIndexHeader), path, hdr->pathLen);
+  }
+
+  // Check every entry before registering any of them.
+  for (uint32 i = 0; ok && i < hdr->num; i++) {
+    int pcs[16];
+    tb_pcs(ent[i].name, pcs);
+    ok =   !ent[i].name[sizeof(ent[i].name) - 1]
+        && ent[i].path < (uint32)num_paths
+        && ent[i].key == calc_key_from_pcs(pcs, 0);
+  }
+
+  if (ok)
+    for (uint32 i = 0; i < hdr->num; i++) {
+      struct TBEntry *entry = add_tb(ent[i].name, ent[i].path);
+      if (entry) {
+        TB_files[tb_index(entry)].size = ent[i].size;
+        TB_files[tb_index(entry)].checksum = ent[i].checksum;
+      }
+    }
+  else
+    printf("info string Ignoring %s, which does not match SyzygyPath.\n", file);
+
+  free(buf);
+  return ok;
+}
+
+// split_paths() splits the SEP_CHAR separated directories of p into a list
+// of strings held by a copy of p, and returns their number.
+static int split_paths(const char *p, char **string, char ***list)
+{
+  int i, j, num = 0;
+  char *s = (char *)malloc(strlen(p) + 1);
+  strcpy(s, p);
+  for (i = 0;; i++) {
+    if (s[i] != SEP_CHAR)
+      num++;
+    while (s[i] && s[i] != SEP_CHAR)
+      i++;
+    if (!s[i]) break;
+    s[i] = 0;
+  }
+  char **l = (char **)malloc(num * sizeof(char *));
+  for (i = j = 0; i < num; i++) {
+    while (!s[j]) j++;
+    l[i] = &s[j];
+    while (s[j]) j++;
+  }
+  *string = s;
+  *list = l;
+  return num;
+}
+
+static void tb_init(char *path, int use_index)
+{
+  int i, j;
+
+  warmup_wait();
+
+  if (!initialized) {
+    init_indices();
+    initialized = 1;
+  }
+
+  // if path_string is set, we need to clean up first.
+  if (path_string) {
+    free(path_string);
+    free(paths);
+    struct TBEntry *entry;
+    for (i = 0; i < TBnum_piece; i++) {
+      entry = (struct TBEntry *)&TB_piece[i];
+      free_wdl_entry(entry);
+    }
+    for (i = 0; i < TBnum_pawn; i++) {
+      entry = (struct TBEntry *)&TB_pawn[i];
+      free_wdl_entry(entry);
+    }
+    dtz_clear();
+    LOCK_DESTROY(TB_mutex);
+    path_string = NULL;
+  }
+
+  // if path is an empty string or equals "<empty>", we are done.
+  const char *p = path;
+  if (strlen(p) == 0 || !strcmp(p, "<empty>")) return;
+
+  num_paths = split_paths(p, &path_string, &paths);
+
+  LOCK_INIT(TB_mutex);
+
+  TBnum_piece = TBnum_pawn = 0;
+  TB_MaxCardinality = 0;
+
+  for (i = 0; i < (1 << TBHASHBITS); i++)
+    for (j = 0; j < HSHMAX; j++) {
+      TB_hash[i][j].key = 0ULL;
+      TB_hash[i][j].ptr = NULL;
+    }
+
+  if (!use_index || !load_index(p))
+    scan_tables(init_tb, NULL);
+
   printf("info string Found %d tablebases.\n", TBnum_piece + TBnum_pawn);
   fflush(stdout);
 }
 
+void TB_init(char *path)
+{
+  tb_init(path, 1);
+}
+
+// An index file being built by TB_write_index() from its own scan of the
+// paths, so that the registered tables are left alone.
+struct IndexScan {
+  char **paths;
+  int num_paths;
+  struct TBIndexEntry *ent;
+  uint32 num, max;
+};
+
+static void index_tb(const char *str, void *arg)
+{
+  struct IndexScan *scan = arg;
+
+  for (int i = 0; i < scan->num_paths; i++) {
+    FD fd = open_tb_dir(scan->paths[i], str, WDLSUFFIX);
+    if (fd == FD_ERR)
+      continue;
+
+    if (scan->num == scan->max) {
+      scan->max = scan->max ? 2 * scan->max : 64;
+      scan->ent = realloc(scan->ent, scan->max * sizeof(struct TBIndexEntry));
+    }
+    struct TBIndexEntry *e = &scan->ent[scan->num++];
+    memset(e, 0, sizeof(*e));
+    uint64 mapping;
+    char *data = map_fd(fd, str, WDLSUFFIX, &mapping, &e->size);
+    int pcs[16];
+    tb_pcs(str, pcs);
+    e->key = calc_key_from_pcs(pcs, 0);
+    strcpy(e->name, str);
+    e->path = i;
+    e->checksum = tb_checksum((ubyte *)data, e->size);
+    unmap_file(data, mapping);
+    return;
+  }
+}
+
+// TB_write_index() looks for the tables in the paths of path, as TB_init()
+// does without an index, and writes their index file to the first path.
+// The tables in use by the search are not touched.
+void TB_write_index(char *path)
+{
+  if (strlen(path) == 0 || !strcmp(path, "<empty>"))
+    return;
+
+  struct IndexScan scan = { 0 };
+  char *string;
+  scan.num_paths = split_paths(path, &string, &scan.paths);
+  scan_tables(index_tb, &scan);
+
+  size_t pathLen = strlen(path);
+  size_t offset = sizeof(struct TBIndexHeader) + ((pathLen + 8) & ~7);
+  size_t size = offset + scan.num * sizeof(struct TBIndexEntry);
+  char *buf = calloc(size, 1);
+  struct TBIndexHeader *hdr = (struct TBIndexHeader *)buf;
+  memcpy(hdr->magic, TBIndexMagic, sizeof(TBIndexMagic));
+  hdr->num = scan.num;
+  hdr->pathLen = (uint32)pathLen;
+  memcpy(buf + sizeof(struct TBIndexHeader), path, pathLen);
+  if (scan.num)
+    memcpy(buf + offset, scan.ent, scan.num * sizeof(struct TBIndexEntry));
+
+  char file[256];
+  snprintf(file, sizeof(file), "%s/" TBINDEX_FILE, scan.paths[0]);
+  FILE *f = fopen(file, "wb");
+  if (f && fwrite(buf, 1, size, f) == size && !fclose(f))
+    printf("info string Wrote index of %u tablebases to %s.\n", hdr->num, file);
+  else {
+    if (f) fclose(f);
+    printf("info string Could not write %s.\n", file);
+  }
+  fflush(stdout);
+  free(buf);
+  free(scan.ent);
+  free(scan.paths);
+  free(string);
+}
+
+// TB_rescan() registers the tables added to the paths of SyzygyPath since
+// TB_init(). Tables already registered keep their entries and mappings, so
+// this is safe while the search is probing them. Tables that were missing
+// or could not be loaded are tried again.
+void TB_rescan(void)
+{
+  if (!path_string)
+    return;
+
+  int num = TBnum_piece + TBnum_pawn;
+  scan_tables(init_tb, NULL);
+
+  IO_LOCK;
+  printf("info string Found %d tablebases, %d new.\n",
+         TBnum_piece + TBnum_pawn, TBnum_piece + TBnum_pawn - num);
+  fflush(stdout);
+  IO_UNLOCK;
+}
+
 static const signed char offdiag[] = {
   0,-1,-1,-1,-1,-1,-1,-1,
   1, 0,-1,-1,-1,-1,-1,-1,
@@ -570,19 +1009,19 @@ static const short KK_idx[10][64] = {
     -1, -1, -1, -1, -1, -1, -1,461 }
 };
 
-static int binomial[5][64];
-static int pawnidx[5][24];
-static int pfactor[5][4];
+static int binomial[TBPIECES - 1][64];
+static int pawnidx[TBPIECES - 1][24];
+static int pfactor[TBPIECES - 1][4];
 
 static void init_indices(void)
 {
   int i, j, k;
 
 // binomial[k-1][n] = Bin(n, k)
-  for (i = 0; i < 5; i++)
+  for (i = 0; i < TBPIECES - 1; i++)
     for (j = 0; j < 64; j++) {
-      int f = j;
-      int l = 1;
+      uint64 f = j;
+      uint64 l = 1;
       for (k = 1; k <= i; k++) {
         f *= (j - k);
         l *= (k + 1);
@@ -590,7 +1029,7 @@ static void init_indices(void)
       binomial[i][j] = f / l;
     }
 
-  for (i = 0; i < 5; i++) {
+  for (i = 0; i < TBPIECES - 1; i++) {
     int s = 0;
     for (j = 0; j < 6; j++) {
       pawnidx[i][j] = s;
@@ -618,7 +1057,7 @@ static void init_indices(void)
   }
 }
 
-static uint64 encode_piece(struct TBEntry_piece *ptr, ubyte *norm, int *pos, int *factor)
+static uint64 encode_piece(struct TBEntry_piece *ptr, ubyte *norm, int *pos, uint64 *factor)
 {
   uint64 idx;
   int i, j, k, m, l, p;
@@ -689,7 +1128,7 @@ static uint64 encode_piece(struct TBEntry_piece *ptr, ubyte *norm, int *pos, int
         j += (p > pos[l]);
       s += binomial[m - i][p - j];
     }
-    idx += ((uint64)s) * ((uint64)factor[i]);
+    idx += ((uint64)s) * factor[i];
     i += t;
   }
 
@@ -708,7 +1147,7 @@ static int pawn_file(struct TBEntry_pawn *ptr, int *pos)
   return file_to_file[pos[0] & 0x07];
 }
 
-static uint64 encode_pawn(struct TBEntry_pawn *ptr, ubyte *norm, int *pos, int *factor)
+static uint64 encode_pawn(struct TBEntry_pawn *ptr, ubyte *norm, int *pos, uint64 *factor)
 {
   uint64 idx;
   int i, j, k, m, s, t;
@@ -743,7 +1182,7 @@ static uint64 encode_pawn(struct TBEntry_pawn *ptr, ubyte *norm, int *pos, int *
         j += (p > pos[k]);
       s += binomial[m - i][p - j - 8];
     }
-    idx += ((uint64)s) * ((uint64)factor[i]);
+    idx += ((uint64)s) * factor[i];
     i = t;
   }
 
@@ -759,7 +1198,7 @@ static uint64 encode_pawn(struct TBEntry_pawn *ptr, ubyte *norm, int *pos, int *
         j += (p > pos[k]);
       s += binomial[m - i][p - j];
     }
-    idx += ((uint64)s) * ((uint64)factor[i]);
+    idx += ((uint64)s) * factor[i];
     i += t;
   }
 
@@ -781,7 +1220,7 @@ static int subfactor(int k, int n)
   return f / l;
 }
 
-static uint64 calc_factors_piece(int *factor, int num, int order, ubyte *norm, ubyte enc_type)
+static uint64 calc_factors_piece(uint64 *factor, int num, int order, ubyte *norm, ubyte enc_type)
 {
   int i, k, n;
   uint64 f;
@@ -805,7 +1244,7 @@ static uint64 calc_factors_piece(int *factor, int num, int order, ubyte *norm, u
   return f;
 }
 
-static uint64 calc_factors_pawn(int *factor, int num, int order, int order2, ubyte *norm, int file)
+static uint64 calc_factors_pawn(uint64 *factor, int num, int order, int order2, ubyte *norm, int file)
 {
   int i, k, n;
   uint64 f;
@@ -1031,12 +1470,23 @@ static int init_table_wdl(struct TBEntry *entry, char *str)
 
   // first mmap the table into memory
 
-  entry->data = map_file(str, WDLSUFFIX, &entry->mapping);
+  struct TBFile *file = &TB_files[tb_index(entry)];
+  uint64 file_size;
+  entry->data = map_file(str, WDLSUFFIX, file->path, &entry->mapping, &file_size);
   if (!entry->data) {
     fprintf(stderr, "Could not find %s" WDLSUFFIX, str);
     return 0;
   }
 
+  if (   file->checksum
+      && (   file_size != file->size
+          || tb_checksum((ubyte *)entry->data, file_size) != file->checksum)) {
+    fprintf(stderr, "%s" WDLSUFFIX " does not match the index.\n", str);
+    unmap_file(entry->data, entry->mapping);
+    entry->data = 0;
+    return 0;
+  }
+
   ubyte *data = (ubyte *)entry->data;
   if (data[0] != WDL_MAGIC[0] ||
       data[1] != WDL_MAGIC[1] ||
@@ -1140,6 +1590,35 @@ static int init_table_wdl(struct TBEntry *entry, char *str)
   return 1;
 }
 
+// setup_map() sets up the four value maps of a DTZ table that starts
+// at data. 7-piece tables may have maps of 16-bit entries (flag 16),
+// in which case map_idx[] counts 16-bit words.
+static ubyte *setup_map(ubyte *map, ubyte *data, ushort *map_idx, ubyte flags)
+{
+  int i;
+
+  if (flags & 16) {
+    data += ((uintptr_t)data) & 0x01;
+    for (i = 0; i < 4; i++) {
+      map_idx[i] = (data - map) / 2 + 1;
+      data += 2 + 2 * (ushort)ReadUshort(data);
+    }
+  } else {
+    for (i = 0; i < 4; i++) {
+      map_idx[i] = data + 1 - map;
+      data += 1 + data[0];
+    }
+  }
+
+  return data;
+}
+
+// read_map() returns the entry of a DTZ value map set up by setup_map().
+INLINE int read_map(ubyte *map, int idx, ubyte flags)
+{
+  return flags & 16 ? (ushort)ReadUshort(map + 2 * idx) : map[idx];
+}
+
 static int init_table_dtz(struct TBEntry *entry)
 {
   ubyte *data = (ubyte *)entry->data;
@@ -1174,11 +1653,7 @@ static int init_table_dtz(struct TBEntry *entry)
 
     ptr->map = data;
     if (ptr->flags & 2) {
-      int i;
-      for (i = 0; i < 4; i++) {
-        ptr->map_idx[i] = data + 1 - ptr->map;
-        data += 1 + data[0];
-      }
+      data = setup_map(ptr->map, data, ptr->map_idx, ptr->flags);
       data += ((uintptr_t)data) & 0x01;
     }
 
@@ -1206,15 +1681,9 @@ static int init_table_dtz(struct TBEntry *entry)
     }
 
     ptr->map = data;
-    for (f = 0; f < files; f++) {
-      if (ptr->flags[f] & 2) {
-        int i;
-        for (i = 0; i < 4; i++) {
-          ptr->map_idx[f][i] = data + 1 - ptr->map;
-          data += 1 + data[0];
-        }
-      }
-    }
+    for (f = 0; f < files; f++)
+      if (ptr->flags[f] & 2)
+        data = setup_map(ptr->map, data, ptr->map_idx[f], ptr->flags[f]);
     data += ((uintptr_t)data) & 0x01;
 
     for (f = 0; f < files; f++) {
@@ -1246,13 +1715,15 @@ INLINE int is_little_endian() {
   return x.c[0] == 1;
 }
 
-static ubyte decompress_pairs(struct PairsData *d, uint64 idx)
+static int decompress_pairs(struct PairsData *d, uint64 idx, TBCache *cache)
 {
   int LittleEndian = is_little_endian();
 
   if (!d->idxbits)
     return d->min_len;
 
+  uint64_t ticks = cache ? cpu_cycles() : 0;
+
   uint32 mainidx = idx >> d->idxbits;
   int litidx = (idx & ((1ULL << d->idxbits) - 1)) - (1ULL << (d->idxbits - 1));
   uint32 block = *(uint32 *)(d->indextable + 6 * mainidx);
@@ -1273,7 +1744,22 @@ static ubyte decompress_pairs(struct PairsData *d, uint64 idx)
       litidx -= d->sizetable[block++] + 1;
   }
 
-  uint32 *ptr = (uint32 *)(d->data + (block << d->blocksize));
+  // Look up the block in the thread's cache. A block is only recorded
+  // from its second probe on, so that scattered probes cost no more than
+  // the lookup.
+  struct TBBlock *b = NULL;
+  if (cache) {
+    unsigned gen = atomic_load_explicit(&TB_generation, memory_order_relaxed);
+    b = &cache->blocks[(((uintptr_t)d >> 4) ^ (block * 0x9e3779b1u)) & (TBCACHE_BLOCKS - 1)];
+    if (b->d != d || b->block != block || b->gen != gen) {
+      b->d = d;
+      b->block = block;
+      b->gen = gen;
+      b->num = b->total = 0;
+      b->ptr = NULL;
+      b = NULL;
+    }
+  }
 
   int m = d->min_len;
   ushort *offset = d->offset;
@@ -1281,31 +1767,109 @@ static ubyte decompress_pairs(struct PairsData *d, uint64 idx)
   ubyte *symlen = d->symlen;
   int sym, bitcnt;
 
-  uint64 code = *((uint64 *)ptr);
-  if (LittleEndian)
-    code = BSWAP64(code);
-
-  ptr += 2;
-  bitcnt = 0; // number of "empty bits" in code
-  for (;;) {
-    int l = m;
-    while (code < base[l]) l++;
-    sym = offset[l];
-    if (!LittleEndian)
-      sym = ((sym & 0xff) << 8) | (sym >> 8);
-    sym += (code - base[l]) >> (64 - l);
-    if (litidx < (int)symlen[sym] + 1) break;
-    litidx -= (int)symlen[sym] + 1;
-    code <<= l;
-    bitcnt += l;
-    if (bitcnt >= 32) {
-      bitcnt -= 32;
-      uint32 tmp = *ptr++;
+  if (b && litidx < b->total) {
+    // The symbol was decoded by an earlier probe.
+    int lo = 0, hi = b->num - 1;
+    while (lo < hi) {
+      int mid = (lo + hi) / 2;
+      if (b->end[mid] > litidx)
+        hi = mid;
+      else
+        lo = mid + 1;
+    }
+    sym = b->sym[lo];
+    litidx -= lo ? b->end[lo - 1] : 0;
+    cache->hits++;
+  }
+  else if (b) {
+    // Resume decoding after the last recorded symbol, whose code length
+    // has not been consumed yet so as not to read beyond the block.
+    uint32 *ptr = b->ptr;
+    uint64 code;
+    int l, total = b->total, num = b->num;
+
+    if (!ptr) {
+      ptr = (uint32 *)(d->data + ((uint64)block << d->blocksize));
+      code = *((uint64 *)ptr);
       if (LittleEndian)
-        tmp = BSWAP32(tmp);
-      code |= ((uint64)tmp) << bitcnt;
+        code = BSWAP64(code);
+      ptr += 2;
+      bitcnt = 0;
+      l = 0;
+    } else {
+      code = b->code;
+      bitcnt = b->bitcnt;
+      l = b->len;
+    }
+
+    for (;;) {
+      code <<= l;
+      bitcnt += l;
+      if (bitcnt >= 32) {
+        bitcnt -= 32;
+        uint32 tmp = *ptr++;
+        if (LittleEndian)
+          tmp = BSWAP32(tmp);
+        code |= ((uint64)tmp) << bitcnt;
+      }
+      l = m;
+      while (code < base[l]) l++;
+      sym = offset[l];
+      if (!LittleEndian)
+        sym = ((sym & 0xff) << 8) | (sym >> 8);
+      sym += (code - base[l]) >> (64 - l);
+      int start = total;
+      total += (int)symlen[sym] + 1;
+      if (num < TBCACHE_SYMS) {
+        b->sym[num] = sym;
+        b->end[num++] = total;
+        if (num == TBCACHE_SYMS || litidx < total) {
+          b->num = num;
+          b->total = total;
+          b->ptr = ptr;
+          b->code = code;
+          b->bitcnt = bitcnt;
+          b->len = l;
+        }
+      }
+      if (litidx < total) {
+        litidx -= start;
+        break;
+      }
+    }
+    cache->misses++;
+  }
+  else {
+    uint32 *ptr = (uint32 *)(d->data + ((uint64)block << d->blocksize));
+
+    uint64 code = *((uint64 *)ptr);
+    if (LittleEndian)
+      code = BSWAP64(code);
+
+    ptr += 2;
+    bitcnt = 0; // number of "empty bits" in code
+    for (;;) {
+      int l = m;
+      while (code < base[l]) l++;
+      sym = offset[l];
+      if (!LittleEndian)
+        sym = ((sym & 0xff) << 8) | (sym >> 8);
+      sym += (code - base[l]) >> (64 - l);
+      if (litidx < (int)symlen[sym] + 1) break;
+      litidx -= (int)symlen[sym] + 1;
+      code <<= l;
+      bitcnt += l;
+      if (bitcnt >= 32) {
+        bitcnt -= 32;
+        uint32 tmp = *ptr++;
+        if (LittleEndian)
+          tmp = BSWAP32(tmp);
+        code |= ((uint64)tmp) << bitcnt;
+       }
      }
-   }
+    if (cache)
+      cache->misses++;
+  }
 
   ubyte *sympat = d->sympat;
   while (symlen[sym] != 0) {
@@ -1319,31 +1883,23 @@ static ubyte decompress_pairs(struct PairsData *d, uint64 idx)
     }
   }
 
-  return sympat[3 * sym];
+  if (cache)
+    cache->ticks += cpu_cycles() - ticks;
+
+  // Values of 7-piece DTZ tables with 16-bit maps can exceed 8 bits.
+  return ((sympat[3 * sym + 1] & 0xf) << 8) | sympat[3 * sym];
 }
 
-void load_dtz_table(char *str, uint64 key1, uint64 key2)
+static struct TBEntry *load_dtz_table(char *str, struct TBEntry *ptr)
 {
-  int i;
-  struct TBEntry *ptr, *ptr3;
-  struct TBHashEntry *ptr2;
-
-  DTZ_table[0].key1 = key1;
-  DTZ_table[0].key2 = key2;
-  DTZ_table[0].entry = NULL;
-
-  // find corresponding WDL entry
-  ptr2 = TB_hash[key1 >> (64 - TBHASHBITS)];
-  for (i = 0; i < HSHMAX; i++)
-    if (ptr2[i].key == key1) break;
-  if (i == HSHMAX) return;
-  ptr = ptr2[i].ptr;
+  struct TBEntry *ptr3;
 
   ptr3 = (struct TBEntry *)malloc(ptr->has_pawns
                                 ? sizeof(struct DTZEntry_pawn)
                                 : sizeof(struct DTZEntry_piece));
 
-  ptr3->data = map_file(str, DTZSUFFIX, &ptr3->mapping);
+  uint64 file_size;
+  ptr3->data = map_file(str, DTZSUFFIX, -1, &ptr3->mapping, &file_size);
   ptr3->key = ptr->key;
   ptr3->num = ptr->num;
   ptr3->symmetric = ptr->symmetric;
@@ -1356,14 +1912,61 @@ void load_dtz_table(char *str, uint64 key1, uint64 key2)
     struct DTZEntry_piece *entry = (struct DTZEntry_piece *)ptr3;
     entry->enc_type = ((struct TBEntry_piece *)ptr)->enc_type;
   }
-  if (!init_table_dtz(ptr3))
+  if (!init_table_dtz(ptr3)) {
+    if (ptr3->data)
+      unmap_file(ptr3->data, ptr3->mapping);
     free(ptr3);
-  else
-    DTZ_table[0].entry = ptr3;
+    return NULL;
+  }
+  return ptr3;
+}
+
+static void dtz_retire(struct TBEntry *entry)
+{
+  struct DTZRetired *r = malloc(sizeof(struct DTZRetired));
+  r->entry = entry;
+  r->next = atomic_load_explicit(&DTZ_retired, memory_order_relaxed);
+  while (!atomic_compare_exchange_weak_explicit(&DTZ_retired, &r->next, r,
+                              memory_order_release, memory_order_relaxed));
+}
+
+// TB_release_dtz() frees the DTZ tables that were evicted from the cache.
+// It must only be called while no other thread is probing.
+void TB_release_dtz(void)
+{
+  struct DTZRetired *r = atomic_exchange(&DTZ_retired, NULL);
+  while (r) {
+    struct DTZRetired *next = r->next;
+    free_dtz_entry(r->entry);
+    free(r);
+    r = next;
+  }
+}
+
+static void dtz_clear(void)
+{
+  for (size_t i = 0; i < DTZ_size; i++) {
+    struct TBEntry *entry = atomic_load(&DTZ_table[i].entry);
+    if (entry)
+      free_dtz_entry(entry);
+    atomic_store(&DTZ_table[i].entry, NULL);
+  }
+  TB_release_dtz();
+}
+
+// TB_set_dtz_cache() resizes the DTZ table cache to the largest power of 2
+// not exceeding num slots. Cached tables are dropped.
+void TB_set_dtz_cache(int num)
+{
+  dtz_clear();
+  free(DTZ_table);
+  for (DTZ_size = 1; 2 * DTZ_size <= (size_t)num; DTZ_size *= 2);
+  DTZ_table = calloc(DTZ_size, sizeof(struct DTZTableEntry));
 }
 
 static void free_wdl_entry(struct TBEntry *entry)
 {
+  atomic_fetch_add(&TB_generation, 1);
   unmap_file(entry->data, entry->mapping);
   if (!entry->has_pawns) {
     struct TBEntry_piece *ptr = (struct TBEntry_piece *)entry;
@@ -1383,6 +1986,7 @@ static void free_wdl_entry(struct TBEntry *entry)
 
 static void free_dtz_entry(struct TBEntry *entry)
 {
+  atomic_fetch_add(&TB_generation, 1);
   unmap_file(entry->data, entry->mapping);
   if (!entry->has_pawns) {
     struct DTZEntry_piece *ptr = (struct DTZEntry_piece *)entry;
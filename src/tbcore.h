@@ -43,9 +43,10 @@
 
 #define WDLSUFFIX ".rtbw"
 #define DTZSUFFIX ".rtbz"
+#define TBINDEX_FILE "syzygy.idx"
 #define WDLDIR "RTBWDIR"
 #define DTZDIR "RTBZDIR"
-#define TBPIECES 6
+#define TBPIECES 7
 
 typedef unsigned long long uint64;
 typedef unsigned int uint32;
@@ -55,7 +56,7 @@ typedef unsigned short ushort;
 const ubyte WDL_MAGIC[4] = { 0x71, 0xe8, 0x23, 0x5d };
 const ubyte DTZ_MAGIC[4] = { 0xd7, 0x66, 0x0c, 0xa5 };
 
-#define TBHASHBITS 10
+#define TBHASHBITS (TBPIECES < 7 ? 10 : 12)
 
 struct TBHashEntry;
 
@@ -98,7 +99,7 @@ struct TBEntry_piece {
   ubyte has_pawns;
   ubyte enc_type;
   struct PairsData *precomp[2];
-  int factor[2][TBPIECES];
+  uint64 factor[2][TBPIECES];
   ubyte pieces[2][TBPIECES];
   ubyte norm[2][TBPIECES];
 };
@@ -114,7 +115,7 @@ struct TBEntry_pawn {
   ubyte pawns[2];
   struct {
     struct PairsData *precomp[2];
-    int factor[2][TBPIECES];
+    uint64 factor[2][TBPIECES];
     ubyte pieces[2][TBPIECES];
     ubyte norm[2][TBPIECES];
   } file[4];
@@ -130,10 +131,10 @@ struct DTZEntry_piece {
   ubyte has_pawns;
   ubyte enc_type;
   struct PairsData *precomp;
-  int factor[TBPIECES];
+  uint64 factor[TBPIECES];
   ubyte pieces[TBPIECES];
   ubyte norm[TBPIECES];
-  ubyte flags; // accurate, mapped, side
+  ubyte flags; // accurate, mapped, side, wide
   ushort map_idx[4];
   ubyte *map;
 };
@@ -149,7 +150,7 @@ struct DTZEntry_pawn {
   ubyte pawns[2];
   struct {
     struct PairsData *precomp;
-    int factor[TBPIECES];
+    uint64 factor[TBPIECES];
     ubyte pieces[TBPIECES];
     ubyte norm[TBPIECES];
   } file[4];
@@ -159,14 +160,53 @@ struct DTZEntry_pawn {
 };
 
 struct TBHashEntry {
-  Key key;
+  _Atomic Key key; // Published with release, read with acquire
   struct TBEntry *ptr;
 };
 
 struct DTZTableEntry {
-  Key key1;
-  Key key2;
+  _Atomic(struct TBEntry *) entry;
+  atomic_uint victim; // Next way to replace, kept in the first way
+};
+
+struct DTZRetired {
   struct TBEntry *entry;
+  struct DTZRetired *next;
+};
+
+struct TBStats {
+  char name[16];
+  atomic_uint dtzLoads;
+  atomic_uint dtzEvictions;
+  atomic_uchar dtzMissing;
+  atomic_uchar warmed;
+};
+
+// The path in which the WDL file of a table was found. Tables registered
+// from an index file also have their size and checksum, which are checked
+// when the table is mapped.
+struct TBFile {
+  int path;
+  uint64 size;
+  uint64 checksum;
+};
+
+// An index file starts with a TBIndexHeader, followed by the SyzygyPath it
+// was made for, padded with zeros to a multiple of 8 bytes, and by num
+// TBIndexEntry records, all in native byte order.
+struct TBIndexHeader {
+  char magic[8];
+  uint32 num;
+  uint32 pathLen;
+};
+
+struct TBIndexEntry {
+  Key key;
+  char name[16];
+  uint32 path;
+  uint32 pad;
+  uint64 size;
+  uint64 checksum;
 };
 
 #endif
@@ -7,10 +7,14 @@
   this code to other chess engines.
 */
 
+#define _GNU_SOURCE
+
 #include "position.h"
 #include "movegen.h"
 #include "bitboard.h"
 #include "search.h"
+#include "thread.h"
+#include "uci.h"
 
 #include "tbprobe.h"
 #include "tbcore.h"
@@ -21,7 +25,23 @@ extern Key mat_key[16];
 
 int TB_MaxCardinality = 0;
 
-// Given a position with 6 or fewer pieces, produce a text string
+// tb_time() adds an event that started at the given cycle count to the
+// thread's timer t. Probes of positions without a cache, such as the UCI
+// position probed by 'd' or at the root, may run while the search threads
+// update their timers, so they are not timed.
+static void tb_time(Pos *pos, int t, uint64_t start)
+{
+  TBCache *cache = pos->tbCache;
+  if (!cache)
+    return;
+  uint64_t ticks = cpu_cycles() - start;
+  struct TBTimer *timer = &cache->timers[t];
+  timer->count++;
+  timer->ticks += ticks;
+  timer->hist[ticks < 128 ? 0 : min(msb(ticks) - 6, TBHIST_BUCKETS - 1)]++;
+}
+
+// Given a position with 7 or fewer pieces, produce a text string
 // of the form KQPvKRP, where "KQP" represents the white pieces if
 // mirror == 0 and the black pieces if mirror == 1.
 static void prt_str(Pos *pos, char *str, int mirror)
@@ -39,22 +59,6 @@ static void prt_str(Pos *pos, char *str, int mirror)
   *str++ = 0;
 }
 
-// Given a position, produce a 64-bit material signature key.
-// If the engine supports such a key, it should equal the engine's key.
-static Key calc_key(Pos *pos, int mirror)
-{
-  Key key = 0;
-
-  int color = !mirror ? WHITE : BLACK;
-  for (int pt = PAWN; pt <= KING; pt++)
-    key += mat_key[pt] * popcount(pieces_cp(color, pt));
-  color ^= 1;
-  for (int pt = PAWN; pt <= KING; pt++)
-    key += mat_key[pt + 8] * popcount(pieces_cp(color, pt));
-
-  return key;
-}
-
 // Produce a 64-bit material key corresponding to the material combination
 // defined by pcs[16], where pcs[1], ..., pcs[6] is the number of white
 // pawns, ..., kings and pcs[9], ..., pcs[14] is the number of black
@@ -77,8 +81,9 @@ static int probe_wdl_table(Pos *pos, int *success)
   struct TBHashEntry *ptr2;
   uint64 idx;
   int i;
-  ubyte res;
+  int res;
   int p[TBPIECES];
+  uint64_t start = cpu_cycles();
 
   // Obtain the position's material signature key.
   Key key = pos_material_key();
@@ -88,8 +93,9 @@ static int probe_wdl_table(Pos *pos, int *success)
     return 0;
 
   ptr2 = TB_hash[key >> (64 - TBHASHBITS)];
+  // Pairs with the release store in add_to_hash(), so that ptr is valid.
   for (i = 0; i < HSHMAX; i++)
-    if (ptr2[i].key == key) break;
+    if (atomic_load_explicit(&ptr2[i].key, memory_order_acquire) == key) break;
   if (i == HSHMAX) {
     *success = 0;
     return 0;
@@ -103,8 +109,11 @@ static int probe_wdl_table(Pos *pos, int *success)
     if (!atomic_load_explicit(&ptr->ready, memory_order_relaxed)) {
       char str[16];
       prt_str(pos, str, ptr->key != key);
-      if (!init_table_wdl(ptr, str)) {
-        ptr2[i].key = 0ULL;
+      uint64_t map_start = cpu_cycles();
+      int ok = init_table_wdl(ptr, str);
+      tb_time(pos, TBT_MAP_WDL, map_start);
+      if (!ok) {
+        atomic_store_explicit(&ptr2[i].key, 0, memory_order_relaxed);
         *success = 0;
         UNLOCK(TB_mutex);
         return 0;
@@ -143,7 +152,7 @@ static int probe_wdl_table(Pos *pos, int *success)
       } while (bb);
     }
     idx = encode_piece(entry, entry->norm[bside], p, entry->factor[bside]);
-    res = decompress_pairs(entry->precomp[bside], idx);
+    res = decompress_pairs(entry->precomp[bside], idx, pos->tbCache);
   } else {
     struct TBEntry_pawn *entry = (struct TBEntry_pawn *)ptr;
     int k = entry->file[0].pieces[0][0] ^ cmirror;
@@ -162,10 +171,236 @@ static int probe_wdl_table(Pos *pos, int *success)
       } while (bb);
     }
     idx = encode_pawn(entry, entry->file[f].norm[bside], p, entry->file[f].factor[bside]);
-    res = decompress_pairs(entry->file[f].precomp[bside], idx);
+    res = decompress_pairs(entry->file[f].precomp[bside], idx, pos->tbCache);
+  }
+
+  tb_time(pos, TBT_WDL_TABLE, start);
+  return res - 2;
+}
+
+// dtz_table() returns the DTZ table with the material of WDL table wdl,
+// loading it into the DTZ cache if necessary, or NULL if it is missing.
+// The cache is DTZ_WAYS-way set associative, so that a few tables with
+// the same hash bits do not keep evicting each other.
+static struct TBEntry *dtz_table(Pos *pos, struct TBEntry *wdl, Key key)
+{
+  if (!DTZ_size)
+    return NULL;
+
+  struct TBStats *stats = &TB_stats[tb_index(wdl)];
+  size_t ways = min(DTZ_size, DTZ_WAYS);
+  struct DTZTableEntry *bucket = &DTZ_table[wdl->key & (DTZ_size - ways)];
+  struct TBEntry *ptr;
+  for (size_t i = 0; i < ways; i++) {
+    ptr = atomic_load_explicit(&bucket[i].entry, memory_order_acquire);
+    if (ptr && ptr->key == wdl->key)
+      return ptr;
+  }
+  if (atomic_load_explicit(&stats->dtzMissing, memory_order_relaxed))
+    return NULL;
+
+  char str[16];
+  prt_str(pos, str, wdl->key != key);
+  uint64_t start = cpu_cycles();
+  struct TBEntry *entry = load_dtz_table(str, wdl);
+  tb_time(pos, TBT_LOAD_DTZ, start);
+  if (!entry) {
+    atomic_store_explicit(&stats->dtzMissing, 1, memory_order_relaxed);
+    return NULL;
+  }
+
+  // Take an empty way of the bucket if there is one, otherwise replace
+  // the ways in turn.
+  struct DTZTableEntry *slot = NULL;
+  for (size_t i = 0; i < ways && !slot; i++)
+    if (!atomic_load_explicit(&bucket[i].entry, memory_order_relaxed))
+      slot = &bucket[i];
+  if (!slot)
+    slot = &bucket[atomic_fetch_add_explicit(&bucket->victim, 1,
+                                     memory_order_relaxed) % ways];
+
+  // Install the table unless another thread has loaded it meanwhile.
+  ptr = atomic_load_explicit(&slot->entry, memory_order_acquire);
+  while (!atomic_compare_exchange_weak_explicit(&slot->entry, &ptr, entry,
+                              memory_order_acq_rel, memory_order_acquire))
+    if (ptr && ptr->key == wdl->key) {
+      free_dtz_entry(entry);
+      return ptr;
+    }
+  atomic_fetch_add_explicit(&stats->dtzLoads, 1, memory_order_relaxed);
+  if (ptr) {
+    struct TBEntry *evicted = wdl_entry(ptr->key);
+    atomic_fetch_add_explicit(&TB_stats[tb_index(evicted)].dtzEvictions, 1,
+                              memory_order_relaxed);
+    dtz_retire(ptr);
+  }
+  return entry;
+}
+
+// tb_reachable() returns whether the material of table str, with the
+// first side being white if mirror == 0, can arise from the material of
+// the position by captures and promotions.
+static int tb_reachable(Pos *pos, const char *str, int mirror)
+{
+  int cnt[2][8] = { { 0 } };
+
+  for (int s = 0; *str; str++)
+    if (*str == 'v')
+      s = 1;
+    else
+      cnt[s][6 - (strchr(pchr, *str) - pchr)]++;
+
+  for (int s = 0; s < 2; s++) {
+    int c = s ^ mirror;
+    int pawns = popcount(pieces_cp(c, PAWN)) - cnt[s][PAWN];
+    if (pawns < 0)
+      return 0;
+    for (int pt = KNIGHT; pt <= QUEEN; pt++) {
+      int extra = cnt[s][pt] - popcount(pieces_cp(c, pt));
+      if (extra > 0 && (pawns -= extra) < 0)
+        return 0;
+    }
+  }
+  return 1;
+}
+
+static const char *TimerNames[TBT_NB] = {
+  "TB_probe_wdl", "TB_probe_dtz", "probe_wdl_table", "init_table_wdl",
+  "load_dtz_table"
+};
+
+// tb_timers() sums the timers of all threads.
+static void tb_timers(struct TBTimer *sum)
+{
+  memset(sum, 0, TBT_NB * sizeof(struct TBTimer));
+  for (size_t idx = 0; idx < Threads.num_threads; idx++) {
+    struct TBTimer *timers = Threads.pos[idx]->tbCache->timers;
+    for (int t = 0; t < TBT_NB; t++) {
+      sum[t].count += timers[t].count;
+      sum[t].ticks += timers[t].ticks;
+      for (int b = 0; b < TBHIST_BUCKETS; b++)
+        sum[t].hist[b] += timers[t].hist[b];
+    }
+  }
+}
+
+// tb_percentile() returns the upper bound in cycles of the histogram bucket
+// holding the duration below which the fraction frac of the events lie.
+static uint64_t tb_percentile(struct TBTimer *timer, double frac)
+{
+  uint64_t n = 0;
+  int b;
+  for (b = 0; b < TBHIST_BUCKETS - 1; b++)
+    if ((n += timer->hist[b]) >= frac * timer->count)
+      break;
+  return (uint64_t)128 << b;
+}
+
+// TB_print_stats() prints, for each thread, its number of probes, the
+// share of blocks served from its block cache and the average time spent
+// decompressing. It then prints the latency histograms of the probing
+// functions over all threads, the occupancy of the DTZ cache and the loads
+// and evictions of each DTZ table.
+void TB_print_stats(void)
+{
+  for (size_t idx = 0; idx < Threads.num_threads; idx++) {
+    TBCache *cache = Threads.pos[idx]->tbCache;
+    uint64_t probes = cache->hits + cache->misses;
+    printf("Thread %zu: %" PRIu64 " wdl probes, %" PRIu64 " dtz probes, "
+           "%" PRIu64 " blocks decoded, %.1f%% block cache hits, "
+           "%" PRIu64 " cycles/block\n", idx,
+           cache->timers[TBT_PROBE_WDL].count,
+           cache->timers[TBT_PROBE_DTZ].count, probes,
+           100.0 * cache->hits / max(probes, 1),
+           cache->ticks / max(probes, 1));
+  }
+
+  struct TBTimer sum[TBT_NB];
+  tb_timers(sum);
+  for (int t = 0; t < TBT_NB; t++) {
+    if (!sum[t].count)
+      continue;
+    printf("%-16s %10" PRIu64 " calls, avg %" PRIu64 " p50 %" PRIu64
+           " p90 %" PRIu64 " p99 %" PRIu64 " cycles\n", TimerNames[t],
+           sum[t].count, sum[t].ticks / sum[t].count,
+           tb_percentile(&sum[t], 0.5), tb_percentile(&sum[t], 0.9),
+           tb_percentile(&sum[t], 0.99));
+    printf("%-16s", "");
+    for (int b = 0; b < TBHIST_BUCKETS; b++)
+      if (sum[t].hist[b])
+        printf(" %s%" PRIu64 ":%" PRIu64, b < TBHIST_BUCKETS - 1 ? "<" : ">=",
+               (uint64_t)(b < TBHIST_BUCKETS - 1 ? 128ULL << b : 64ULL << b),
+               sum[t].hist[b]);
+    printf("\n");
+  }
+
+  size_t used = 0;
+  for (size_t i = 0; i < DTZ_size; i++)
+    used += atomic_load_explicit(&DTZ_table[i].entry, memory_order_relaxed) != NULL;
+  printf("DTZ cache: %zu slots, %zu ways, %zu in use\n", DTZ_size,
+         min(DTZ_size, DTZ_WAYS), used);
+
+  for (int i = 0; i < TBMAX_PIECE + TBMAX_PAWN; i++) {
+    if (!path_string || (i < TBMAX_PIECE ? i >= TBnum_piece
+                                         : i >= TBMAX_PIECE + TBnum_pawn))
+      continue;
+    struct TBStats *stats = &TB_stats[i];
+    if (stats->dtzLoads || stats->dtzMissing)
+      printf("%-10s loads %6u evictions %6u%s\n", stats->name,
+             stats->dtzLoads, stats->dtzEvictions,
+             stats->dtzMissing ? " (missing)" : "");
+  }
+  fflush(stdout);
+}
+
+// TB_print_info() sends the number and latency of the probes of all
+// threads as an info string. It is called periodically during the search
+// if SyzygyStats is set.
+void TB_print_info(void)
+{
+  struct TBTimer sum[TBT_NB];
+  tb_timers(sum);
+
+  IO_LOCK;
+  printf("info string TB stats:");
+  for (int t = 0; t < TBT_NB; t++)
+    if (sum[t].count)
+      printf(" %s %" PRIu64 " avg %" PRIu64 " p99 %" PRIu64, TimerNames[t],
+             sum[t].count, sum[t].ticks / sum[t].count,
+             tb_percentile(&sum[t], 0.99));
+  printf(" (cycles)\n");
+  fflush(stdout);
+  IO_UNLOCK;
+}
+
+// TB_warmup() starts mapping and reading ahead, in the background, the
+// WDL tables that the search may reach from the given position. Nothing
+// is done if the position has more than WARMUP_MARGIN pieces over the
+// largest tables. A warm-up still running for an earlier position is
+// stopped first.
+void TB_warmup(Pos *pos)
+{
+  int num = popcount(pieces());
+
+  if (!path_string || num > TB_MaxCardinality + WARMUP_MARGIN)
+    return;
+
+  warmup_wait();
+  warm_num = 0;
+  for (int i = 0; i < TBMAX_PIECE + TBMAX_PAWN; i++) {
+    if (i < TBMAX_PIECE ? i >= TBnum_piece : i >= TBMAX_PIECE + TBnum_pawn)
+      continue;
+    struct TBEntry *ptr = i < TBMAX_PIECE ? (struct TBEntry *)&TB_piece[i]
+                          : (struct TBEntry *)&TB_pawn[i - TBMAX_PIECE];
+    struct TBStats *stats = &TB_stats[i];
+    if (   !stats->warmed && ptr->num <= num
+        && (   tb_reachable(pos, stats->name, 0)
+            || tb_reachable(pos, stats->name, 1)))
+      warm_list[warm_num++] = ptr;
   }
 
-  return ((int)res) - 2;
+  if (warm_num)
+    warmup_start();
 }
 
 // The value of wdl MUST correspond to the WDL value of the position without
@@ -180,35 +415,13 @@ static int probe_dtz_table(Pos *pos, int wdl, int *success)
   // Obtain the position's material signature key.
   Key key = pos_material_key();
 
-  if (DTZ_table[0].key1 != key && DTZ_table[0].key2 != key) {
-    for (i = 1; i < DTZ_ENTRIES; i++)
-      if (DTZ_table[i].key1 == key || DTZ_table[i].key2 == key) break;
-    if (i < DTZ_ENTRIES) {
-      struct DTZTableEntry table_entry = DTZ_table[i];
-      for (; i > 0; i--)
-        DTZ_table[i] = DTZ_table[i - 1];
-      DTZ_table[0] = table_entry;
-    } else {
-      struct TBHashEntry *ptr2 = TB_hash[key >> (64 - TBHASHBITS)];
-      for (i = 0; i < HSHMAX; i++)
-        if (ptr2[i].key == key) break;
-      if (i == HSHMAX) {
-        *success = 0;
-        return 0;
-      }
-      ptr = ptr2[i].ptr;
-      char str[16];
-      int mirror = (ptr->key != key);
-      prt_str(pos, str, mirror);
-      if (DTZ_table[DTZ_ENTRIES - 1].entry)
-        free_dtz_entry(DTZ_table[DTZ_ENTRIES-1].entry);
-      for (i = DTZ_ENTRIES - 1; i > 0; i--)
-        DTZ_table[i] = DTZ_table[i - 1];
-      load_dtz_table(str, calc_key(pos, mirror), calc_key(pos, !mirror));
-    }
+  ptr = wdl_entry(key);
+  if (!ptr) {
+    *success = 0;
+    return 0;
   }
 
-  ptr = DTZ_table[0].entry;
+  ptr = dtz_table(pos, ptr, key);
   if (!ptr) {
     *success = 0;
     return 0;
@@ -244,10 +457,11 @@ static int probe_dtz_table(Pos *pos, int wdl, int *success)
       } while (bb);
     }
     idx = encode_piece((struct TBEntry_piece *)entry, entry->norm, p, entry->factor);
-    res = decompress_pairs(entry->precomp, idx);
+    res = decompress_pairs(entry->precomp, idx, pos->tbCache);
 
     if (entry->flags & 2)
-      res = entry->map[entry->map_idx[wdl_to_map[wdl + 2]] + res];
+      res = read_map(entry->map, entry->map_idx[wdl_to_map[wdl + 2]] + res,
+                     entry->flags);
 
     if (!(entry->flags & pa_flags[wdl + 2]) || (wdl & 1))
       res *= 2;
@@ -273,10 +487,11 @@ static int probe_dtz_table(Pos *pos, int wdl, int *success)
       } while (bb);
     }
     idx = encode_pawn((struct TBEntry_pawn *)entry, entry->file[f].norm, p, entry->file[f].factor);
-    res = decompress_pairs(entry->file[f].precomp, idx);
+    res = decompress_pairs(entry->file[f].precomp, idx, pos->tbCache);
 
     if (entry->flags[f] & 2)
-      res = entry->map[entry->map_idx[f][wdl_to_map[wdl + 2]] + res];
+      res = read_map(entry->map, entry->map_idx[f][wdl_to_map[wdl + 2]] + res,
+                     entry->flags[f]);
 
     if (!(entry->flags[f] & pa_flags[wdl + 2]) || (wdl & 1))
       res *= 2;
@@ -353,7 +568,7 @@ static int probe_ab(Pos *pos, int alpha, int beta, int *success)
 //  0 : draw
 //  1 : win, but draw under 50-move rule
 //  2 : win
-int TB_probe_wdl(Pos *pos, int *success)
+static int probe_wdl(Pos *pos, int *success)
 {
   *success = 1;
 
@@ -481,9 +696,9 @@ static int wdl_to_dtz[] = {
 // In short, if a move is available resulting in dtz + 50-move-counter <= 99,
 // then do not accept moves leading to dtz + 50-move-counter == 100.
 //
-int TB_probe_dtz(Pos *pos, int *success)
+static int probe_dtz(Pos *pos, int *success)
 {
-  int wdl = TB_probe_wdl(pos, success);
+  int wdl = probe_wdl(pos, success);
   if (*success == 0) return 0;
 
   // If draw, then dtz = 0.
@@ -493,7 +708,7 @@ int TB_probe_dtz(Pos *pos, int *success)
   if (*success == 2)
     return wdl_to_dtz[wdl + 2];
 
-  ExtMove *end, *m = (pos->st-1)->endMoves;
+  ExtMove *end = NULL, *m = (pos->st-1)->endMoves;
 
   // If winning, check for a winning pawn move.
   if (wdl > 0) {
@@ -512,7 +727,7 @@ int TB_probe_dtz(Pos *pos, int *success)
                 || !is_legal(pos, move))
         continue;
       do_move(pos, move, gives_check(pos, pos->st, move));
-      int v = -TB_probe_wdl(pos, success);
+      int v = -probe_wdl(pos, success);
       undo_move(pos, move);
       if (*success == 0) return 0;
       if (v == wdl)
@@ -557,7 +772,7 @@ int TB_probe_dtz(Pos *pos, int *success)
               || !is_legal(pos, move))
       continue;
     do_move(pos, move, gives_check(pos, pos->st, move));
-    int v = -TB_probe_dtz(pos, success);
+    int v = -probe_dtz(pos, success);
     undo_move(pos, move);
     if (*success == 0) return 0;
     if (wdl > 0) {
@@ -571,6 +786,24 @@ int TB_probe_dtz(Pos *pos, int *success)
   return best;
 }
 
+// TB_probe_wdl() and TB_probe_dtz() are probe_wdl() and probe_dtz() timed
+// for the statistics of the probing thread.
+int TB_probe_wdl(Pos *pos, int *success)
+{
+  uint64_t start = cpu_cycles();
+  int v = probe_wdl(pos, success);
+  tb_time(pos, TBT_PROBE_WDL, start);
+  return v;
+}
+
+int TB_probe_dtz(Pos *pos, int *success)
+{
+  uint64_t start = cpu_cycles();
+  int v = probe_dtz(pos, success);
+  tb_time(pos, TBT_PROBE_DTZ, start);
+  return v;
+}
+
 // Check whether there has been at least one repetition of positions
 // since the last capture or pawn move.
 static int has_repeated(Pos *pos)
@@ -599,6 +832,74 @@ static Value wdl_to_Value[5] = {
   VALUE_MATE - MAX_PLY - 1
 };
 
+// Root moves are probed in parallel by the threads of the pool. The moves
+// are ordered by the material they lead to and handed out in chunks, so
+// that each thread probes consecutive moves into the same table.
+static struct {
+  Pos *root;
+  ExtMove *rm;
+  int order[MAX_MOVES];
+  size_t num, chunk;
+  int dtz;
+  atomic_size_t next, done;
+  atomic_bool failed;
+} RootProbe;
+
+// Material signature of the position after move m relative to the root:
+// the type of the captured piece and the promotion piece, if any.
+static int move_material(Pos *pos, Move m)
+{
+  int captured =  type_of_m(m) == ENPASSANT ? PAWN
+                : type_of_m(m) == CASTLING  ? 0
+                : type_of_p(piece_on(to_sq(m)));
+  return captured * 8 + (type_of_m(m) == PROMOTION ? promotion_type(m) : 0);
+}
+
+static int probe_root_move(Pos *pos, Move move, int dtz, int *success)
+{
+  int v = 0;
+
+  do_move(pos, move, gives_check(pos, pos->st, move));
+  // Testing for mate should only be necessary if dtz == 1.
+  if (pos_checkers() && dtz > 0) {
+    if (generate_legal(pos, (pos->st-1)->endMoves) == (pos->st-1)->endMoves)
+      v = 1;
+  }
+  if (!v) {
+    if (pos_rule50_count() != 0) {
+      v = -TB_probe_dtz(pos, success);
+      if (v > 0) v++;
+      else if (v < 0) v--;
+    } else {
+      v = -TB_probe_wdl(pos, success);
+      v = wdl_to_dtz[v + 2];
+    }
+  }
+  undo_move(pos, move);
+
+  return v;
+}
+
+static void root_probe_task(Pos *pos)
+{
+  pos_copy(pos, RootProbe.root);
+  (pos->st-1)->endMoves = pos->st->endMoves = pos->moveList;
+
+  size_t i;
+  while ((i = atomic_fetch_add(&RootProbe.next, RootProbe.chunk)) < RootProbe.num) {
+    size_t end = min(i + RootProbe.chunk, RootProbe.num);
+    for (; i < end && !atomic_load(&RootProbe.failed); i++) {
+      ExtMove *m = &RootProbe.rm[RootProbe.order[i]];
+      int success = 1;
+      m->value = probe_root_move(pos, m->move, RootProbe.dtz, &success);
+      if (!success)
+        atomic_store(&RootProbe.failed, 1);
+      else
+        atomic_fetch_add(&RootProbe.done, 1);
+    }
+  }
+}
+
 // Use the DTZ tables to filter out root moves that do not preserve the
 // win or draw. If the position is lost, but DTZ is fairly high, only keep
 // moves that maximise DTZ.
@@ -613,31 +914,35 @@ int TB_root_probe(Pos *pos, ExtMove *rm, size_t *num_moves, Value *score)
   if (!success) return 0;
 
   // Probe each move.
+  TimePoint start = now();
   size_t num = *num_moves;
-  pos->st->endMoves = (pos->st-1)->endMoves;
+  int key[MAX_MOVES];
   for (size_t i = 0; i < num; i++) {
-    do_move(pos, rm[i].move, gives_check(pos, pos->st, rm[i].move));
-    int v = 0;
-    // Testing for mate should only be necessary if dtz == 1.
-    if (pos_checkers() && dtz > 0) {
-      if (generate_legal(pos, (pos->st-1)->endMoves) == (pos->st-1)->endMoves)
-        v = 1;
-    }
-    if (!v) {
-      if (pos_rule50_count() != 0) {
-        v = -TB_probe_dtz(pos, &success);
-        if (v > 0) v++;
-        else if (v < 0) v--;
-      } else {
-        v = -TB_probe_wdl(pos, &success);
-        v = wdl_to_dtz[v + 2];
-      }
-    }
-    undo_move(pos, rm[i].move);
-    if (!success) return 0;
-    rm[i].value = v;
+    key[i] = move_material(pos, rm[i].move);
+    size_t j = i;
+    for (; j > 0 && key[RootProbe.order[j - 1]] > key[i]; j--)
+      RootProbe.order[j] = RootProbe.order[j - 1];
+    RootProbe.order[j] = i;
+  }
+  RootProbe.root = pos;
+  RootProbe.rm = rm;
+  RootProbe.num = num;
+  RootProbe.chunk = max(num / (4 * Threads.num_threads), 1);
+  RootProbe.dtz = dtz;
+  atomic_store(&RootProbe.next, 0);
+  atomic_store(&RootProbe.done, 0);
+  atomic_store(&RootProbe.failed, 0);
+  int ran = threads_run(root_probe_task);
+
+  if (option_value(OPT_SYZ_STATS)) {
+    printf("info string Root TB probe: %zu moves, %zu threads, %" PRIu64 " ms\n",
+           num, Threads.num_threads, (uint64_t)(now() - start));
+    fflush(stdout);
   }
 
+  // Moves that were not probed have no value, so only filter if all were.
+  if (!ran || atomic_load(&RootProbe.done) != num) return 0;
+
   // Obtain 50-move counter for the root position.
   int cnt50 = pos_rule50_count();
 
@@ -5,8 +5,56 @@
 
 extern int TB_MaxCardinality;
 
+#define TBCACHE_BLOCKS 32
+#define TBCACHE_SYMS 256
+
+// A block of compressed table data, decoded up to some symbol. sym[] and
+// end[] hold the symbols decoded so far and the index following each of
+// them. The remaining fields are the state of the decoder.
+struct TBBlock {
+  struct PairsData *d;
+  uint32_t block;
+  unsigned gen;
+  int num, total;
+  uint32_t *ptr;
+  uint64_t code;
+  int bitcnt, len;
+  uint16_t sym[TBCACHE_SYMS];
+  int end[TBCACHE_SYMS];
+};
+
+#define TBHIST_BUCKETS 24
+
+enum {
+  TBT_PROBE_WDL, TBT_PROBE_DTZ, TBT_WDL_TABLE, TBT_MAP_WDL, TBT_LOAD_DTZ,
+  TBT_NB
+};
+
+// The number and total duration in cycles of timed events, with a
+// histogram of the durations by powers of two starting from 128 cycles.
+struct TBTimer {
+  uint64_t count, ticks;
+  uint64_t hist[TBHIST_BUCKETS];
+};
+
+// Each thread keeps a small direct-mapped cache of the blocks it decoded
+// last, counts how many probes it served from it and times its probes.
+struct TBCache {
+  struct TBBlock blocks[TBCACHE_BLOCKS];
+  uint64_t hits, misses;
+  uint64_t ticks;
+  struct TBTimer timers[TBT_NB];
+};
+
 void TB_init(char *path);
 void TB_free(void);
+void TB_rescan(void);
+void TB_write_index(char *path);
+void TB_set_dtz_cache(int num);
+void TB_release_dtz(void);
+void TB_print_stats(void);
+void TB_print_info(void);
+void TB_warmup(Pos *pos);
 int TB_probe_wdl(Pos *pos, int *success);
 int TB_probe_dtz(Pos *pos, int *success);
 int TB_root_probe(Pos *pos, ExtMove *rm, size_t *num_moves, Value *score);
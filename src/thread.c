@@ -68,23 +68,25 @@ void thread_init(void *arg)
   if (settings.numa_enabled) {
     pos = numa_alloc(sizeof(Pos));
     pos->pawnTable = numa_alloc(16384 * sizeof(PawnEntry));
-    pos->materialTable = numa_alloc(8192 * sizeof(MaterialEntry));
+    pos->materialTable = numa_alloc(sizeof(MaterialTable));
     pos->history = numa_alloc(sizeof(HistoryStats));
     pos->counterMoves = numa_alloc(sizeof(MoveStats));
     pos->fromTo = numa_alloc(sizeof(FromToStats));
     pos->rootMoves = numa_alloc(sizeof(RootMoves));
     pos->stack = numa_alloc((5 + MAX_PLY + 10) * sizeof(Stack));
     pos->moveList = numa_alloc(10000 * sizeof(ExtMove));
+    pos->tbCache = numa_alloc(sizeof(TBCache));
   } else {
     pos = calloc(sizeof(Pos), 1);
     pos->pawnTable = calloc(16384 * sizeof(PawnEntry), 1);
-    pos->materialTable = calloc(8192 * sizeof(MaterialEntry), 1);
+    pos->materialTable = calloc(sizeof(MaterialTable), 1);
     pos->history = calloc(sizeof(HistoryStats), 1);
     pos->counterMoves = calloc(sizeof(MoveStats), 1);
     pos->fromTo = calloc(sizeof(FromToStats), 1);
     pos->rootMoves = calloc(sizeof(RootMoves), 1);
     pos->stack = calloc((5 + MAX_PLY + 10) * sizeof(Stack), 1);
     pos->moveList = calloc(10000 * sizeof(ExtMove), 1);
+    pos->tbCache = calloc(sizeof(TBCache), 1);
   }
   pos->thread_idx = idx;
   pos->stack += 5;
@@ -105,6 +107,10 @@ void thread_init(void *arg)
   Threads.pos[idx] = pos;
 
 #ifndef __WIN32__
+  // The thread counts as searching until it has parked itself in the idle
+  // loop, so that thread_create() can wait for that to happen.
+  pos->searching = 1;
+
   pthread_mutex_lock(&Threads.mutex);
   Threads.initializing = 0;
   pthread_cond_signal(&Threads.sleepCondition);
@@ -129,6 +135,10 @@ void thread_create(int idx)
   while (Threads.initializing)
     pthread_cond_wait(&Threads.sleepCondition, &Threads.mutex);
   pthread_mutex_unlock(&Threads.mutex);
+
+  // Make sure the thread is sleeping in the idle loop before it can be
+  // woken up, or the wake-up would be lost.
+  thread_wait_for_search_finished(Threads.pos[idx]);
 #else
   HANDLE *thread = CreateThread(NULL, 0, (LPTHREAD_START_ROUTINE)thread_init, (void *)(intptr_t)idx, 0 , NULL);
   WaitForSingleObject(Threads.event, INFINITE);
@@ -160,13 +170,14 @@ void thread_destroy(Pos *pos)
 
   if (settings.numa_enabled) {
     numa_free(pos->pawnTable, 16384 * sizeof(PawnEntry));
-    numa_free(pos->materialTable, 8192 * sizeof(MaterialEntry));
+    numa_free(pos->materialTable, sizeof(MaterialTable));
     numa_free(pos->history, sizeof(HistoryStats));
     numa_free(pos->counterMoves, sizeof(MoveStats));
     numa_free(pos->fromTo, sizeof(FromToStats));
     numa_free(pos->rootMoves, sizeof(RootMoves));
     numa_free(pos->stack - 5, (5 + MAX_PLY + 10) * sizeof(Stack));
     numa_free(pos->moveList, 10000 * sizeof(ExtMove));
+    numa_free(pos->tbCache, sizeof(TBCache));
     numa_free(pos, sizeof(Pos));
   } else {
     free(pos->pawnTable);
@@ -177,6 +188,7 @@ void thread_destroy(Pos *pos)
     free(pos->rootMoves);
     free(pos->stack - 5);
     free(pos->moveList);
+    free(pos->tbCache);
     free(pos);
   }
 }
@@ -240,10 +252,11 @@ void thread_start_searching(Pos *pos, int resume)
 
 void thread_idle_loop(Pos *pos)
 {
-  while (!pos->exit) {
+  while (1) {
 #ifndef __WIN32__
     pthread_mutex_lock(&pos->mutex);
 
+    // Clear the flag only now that the previous task or search is done.
     pos->searching = 0;
 
     while (!pos->searching && !pos->exit) {
@@ -253,27 +266,62 @@ void thread_idle_loop(Pos *pos)
 
     pthread_mutex_unlock(&pos->mutex);
 
-    if (!pos->exit) {
-      if (pos->thread_idx == 0)
-        mainthread_search();
-      else
-        thread_search(pos);
-    }
+    if (pos->exit)
+      break;
+
+    if (Threads.task) {
+      Threads.task(pos);
+      atomic_fetch_add(&Threads.tasksDone, 1);
+    } else if (pos->thread_idx == 0)
+      mainthread_search();
+    else
+      thread_search(pos);
 #else
 //    pos->searching = 0;
     WaitForSingleObject(pos->startEvent, INFINITE);
-    if (!pos->exit) {
-      if (pos->thread_idx == 0)
-        mainthread_search();
-      else
-        thread_search(pos);
-    }
+    if (pos->exit)
+      break;
+    if (Threads.task) {
+      Threads.task(pos);
+      atomic_fetch_add(&Threads.tasksDone, 1);
+    } else if (pos->thread_idx == 0)
+      mainthread_search();
+    else
+      thread_search(pos);
     SetEvent(pos->stopEvent);
 #endif
   }
 }
 
 
+// threads_run() runs task() on all threads of the pool and waits for all
+// of them to finish. This lets non-search work, such as batch evaluation,
+// use the threads and their thread-specific tables. It returns 0 if not
+// every thread ran the task.
+
+int threads_run(void (*task)(Pos *pos))
+{
+  Threads.task = task;
+  atomic_store(&Threads.tasksDone, 0);
+
+  for (size_t idx = 0; idx < Threads.num_threads; idx++)
+    thread_start_searching(Threads.pos[idx], 0);
+
+  for (size_t idx = 0; idx < Threads.num_threads; idx++)
+    thread_wait_for_search_finished(Threads.pos[idx]);
+
+  Threads.task = NULL;
+
+  size_t done = atomic_load(&Threads.tasksDone);
+  if (done != Threads.num_threads) {
+    fprintf(stderr, "Error: task ran on %zu of %zu threads\n",
+            done, Threads.num_threads);
+    return 0;
+  }
+  return 1;
+}
+
+
 // threads_init() creates and launches requested threads that will go
 // immediately to sleep. We cannot use a constructor because Threads is a
 // static object and we need a fully initialized engine at this point due to
@@ -379,6 +427,10 @@ void threads_start_thinking(Pos *root, LimitsType *limits)
   if (Signals.searching)
     thread_wait_for_search_finished(threads_main());
 
+  // No thread is probing now, so DTZ tables evicted from the cache during
+  // the previous search can be freed.
+  TB_release_dtz();
+
   Signals.stopOnPonderhit = Signals.stop = 0;
   Limits = *limits;
 
@@ -77,6 +77,8 @@ void mainthread_search();
 struct ThreadPool {
   Pos *pos[MAX_THREADS];
   size_t num_threads;
+  void (*task)(Pos *pos); // Run by threads_run() instead of a search
+  atomic_size_t tasksDone;
 #ifndef __WIN32__
   pthread_mutex_t mutex;
   pthread_cond_t sleepCondition;
@@ -92,6 +94,7 @@ void threads_init(void);
 void threads_exit(void);
 void threads_start_thinking(Pos *pos, LimitsType *);
 void threads_set_number(size_t num);
+int threads_run(void (*task)(Pos *pos));
 uint64_t threads_nodes_searched(void);
 uint64_t threads_tb_hits(void);
 
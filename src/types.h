@@ -41,6 +41,12 @@
 // -DUSE_PEXT    | Add runtime support for use of pext asm-instruction.
 //               | Works only in 64-bit mode and requires hardware with
 //               | pext support.
+//
+// -DUSE_AVX2    | Use AVX2 to score and pick moves in the move picker.
+//               | Requires hardware with AVX2 support.
+//
+// -DUSE_DISPATCH | Choose between magic and pext slider attacks at startup
+//               | depending on the CPU. Requires hardware with popcnt.
 
 #ifndef NDEBUG
 #include <assert.h>
@@ -396,6 +402,8 @@ typedef struct LimitsType LimitsType;
 typedef struct RootMoves RootMoves;
 typedef struct PawnEntry PawnEntry;
 typedef struct MaterialEntry MaterialEntry;
+typedef struct MaterialHashEntry MaterialHashEntry;
+typedef struct TBCache TBCache;
 
 typedef Move MoveStats[16][64];
 typedef Value HistoryStats[16][64];
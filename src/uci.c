@@ -29,11 +29,14 @@
 #include "position.h"
 #include "search.h"
 #include "settings.h"
+#include "tbprobe.h"
 #include "thread.h"
 #include "timeman.h"
 #include "uci.h"
 
 extern void benchmark(Pos *pos, char *str);
+extern void eval_prof(Pos *pos, char *str);
+extern void eval_batch(char *str);
 
 // FEN string of the initial position, normal chess
 const char* StartFEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
@@ -73,6 +76,22 @@ void position(Pos *pos, char *str)
       do_move(pos, m, gives_check(pos, pos->st, m));
       pos->gamePly++;
     }
+
+  if (option_value(OPT_SYZ_WARMUP))
+    TB_warmup(pos);
+}
+
+
+// write_tb_index() writes the tablebase index file for the given paths,
+// or for SyzygyPath if none are given.
+
+static void write_tb_index(char *str)
+{
+  size_t len = strlen(str);
+  while (len && isblank(str[len - 1]))
+    str[--len] = 0;
+
+  TB_write_index(*str ? str : option_string_value(OPT_SYZ_PATH));
 }
 
 
@@ -187,6 +206,7 @@ void uci_loop(int argc, char **argv)
   pos.stack++;
   pos.moveList = malloc(1000 * sizeof(ExtMove));
   pos.stack[-1].endMoves = pos.moveList;
+  pos.tbCache = NULL;
 
   size_t buf_size = 1;
   for (int i = 1; i < argc; i++)
@@ -270,7 +290,15 @@ void uci_loop(int argc, char **argv)
     // Additional custom non-UCI commands, useful for debugging
     else if (strcmp(token, "bench") == 0)     benchmark(&pos, str);
     else if (strcmp(token, "d") == 0)         print_pos(&pos);
-//    else if (strcmp(token, "eval") == 0)      eval_trace(stdout, &pos);
+    else if (strcmp(token, "tbstats") == 0)   TB_print_stats();
+    else if (strcmp(token, "tbindex") == 0)   write_tb_index(str);
+    else if (strcmp(token, "evalprof") == 0)  eval_prof(&pos, str);
+    else if (strcmp(token, "evalbatch") == 0) eval_batch(str);
+    else if (strcmp(token, "eval") == 0) {
+      pos.pawnTable = threads_main()->pawnTable;
+      pos.materialTable = threads_main()->materialTable;
+      eval_trace(&pos);
+    }
     else if (strcmp(token, "perft") == 0) {
       char str2[64];
       sprintf(str2, "%d %d %d current perft", option_value(OPT_HASH),
@@ -54,8 +54,13 @@ typedef void (*OnChange)(Option *);
 #define OPT_SYZ_PROBE_DEPTH 14
 #define OPT_SYZ_50_MOVE     15
 #define OPT_SYZ_PROBE_LIMIT 16
-#define OPT_LARGE_PAGES     17
-#define OPT_NUMA            18
+#define OPT_SYZ_DTZ_CACHE   17
+#define OPT_SYZ_WARMUP      18
+#define OPT_SYZ_STATS       19
+#define OPT_SYZ_RESCAN      20
+#define OPT_BITBASES        21
+#define OPT_LARGE_PAGES     22
+#define OPT_NUMA            23
 
 struct Option {
   char *name;
@@ -68,6 +68,26 @@ static void on_tb_path(Option *opt)
   TB_init(opt->val_string);
 }
 
+static void on_tb_rescan(Option *opt)
+{
+  (void)opt;
+
+  TB_rescan();
+}
+
+static void on_dtz_cache(Option *opt)
+{
+  TB_set_dtz_cache(opt->value);
+}
+
+static void on_bitbases(Option *opt)
+{
+  if (opt->value)
+    bitbases_generate();
+  else
+    bitbases_free();
+}
+
 static void on_largepages(Option *opt)
 {
   delayed_settings.large_pages = opt->value;
@@ -96,7 +116,12 @@ static Option options_map[] = {
   { "SyzygyPath", OPT_TYPE_STRING, 0, 0, 0, "<empty>", on_tb_path, 0, NULL },
   { "SyzygyProbeDepth", OPT_TYPE_SPIN, 1, 1, 100, NULL, NULL, 0, NULL },
   { "Syzygy50MoveRule", OPT_TYPE_CHECK, 1, 0, 0, NULL, NULL, 0, NULL },
-  { "SyzygyProbeLimit", OPT_TYPE_SPIN, 6, 0, 6, NULL, NULL, 0, NULL },
+  { "SyzygyProbeLimit", OPT_TYPE_SPIN, 7, 0, 7, NULL, NULL, 0, NULL },
+  { "SyzygyDTZCache", OPT_TYPE_SPIN, 64, 1, 4096, NULL, on_dtz_cache, 0, NULL },
+  { "SyzygyWarmup", OPT_TYPE_CHECK, 0, 0, 0, NULL, NULL, 0, NULL },
+  { "SyzygyStats", OPT_TYPE_CHECK, 0, 0, 0, NULL, NULL, 0, NULL },
+  { "SyzygyRescan", OPT_TYPE_BUTTON, 0, 0, 0, NULL, on_tb_rescan, 0, NULL },
+  { "Bitbases", OPT_TYPE_CHECK, 0, 0, 0, NULL, on_bitbases, 0, NULL },
   { "LargePages", OPT_TYPE_CHECK, 1, 0, 0, NULL, on_largepages, 0, NULL },
 #ifdef NUMA
   { "NUMA", OPT_TYPE_STRING, 0, 0, 0, "all", on_numa, 0, NULL },